@@ -90,6 +90,22 @@
 #define LSM303DLHC_OUT_Y_H_M     0x07
 #define LSM303DLHC_OUT_Y_L_M     0x08
 
+// magnetometer calibration record, kept in EEPROM by the calibrate sketch
+
+#define LSM303_CAL_ADDRESS       0      // EEPROM address of the record
+#define LSM303_CAL_MAGIC         0x4D43 // "CM"
+#define LSM303_CAL_VERSION       1
+#define LSM303_CAL_ONE           256    // scale of 1.0
+
+typedef struct
+{
+  uint16_t magic;
+  uint8_t version;
+  int16_t offset[3];  // hard iron: subtracted from the raw x, y, z
+  int16_t scale[3];   // soft iron: then multiplied by scale / LSM303_CAL_ONE
+  uint8_t check;      // ~(sum of the bytes above)
+} lsm303_calibration;
+
 class LSM303
 {
   public:
@@ -1,19 +1,68 @@
 #include <Wire.h>
 #include <LSM303.h>
+#include <avr/eeprom.h>
 
 LSM303 compass;
 LSM303::vector running_min = {2047, 2047, 2047}, running_max = {-2048, -2048, -2048};
 
+// Same checksum as the client's LSM303::loadCalibration()
+uint8_t calibration_check(const lsm303_calibration *cal) {
+  const uint8_t *p = (const uint8_t *) cal;
+  uint8_t sum = 0;
+  for (byte i = 0; i < sizeof(*cal) - 1; i++) sum += p[i];
+  return ~sum;
+}
+
+// Turns the running min/max into offsets and scales and stores them for
+// the client to load at boot.  The scales stretch each axis to the mean
+// radius, which takes out the simplest soft iron distortion.
+void save_calibration() {
+  float lo[3] = {running_min.x, running_min.y, running_min.z};
+  float hi[3] = {running_max.x, running_max.y, running_max.z};
+  float radius[3];
+  float mean = 0;
+
+  for (int i = 0; i < 3; i++) {
+    if (hi[i] <= lo[i]) {
+      Serial.println("Not saved, turn the compass through every axis first");
+      return;
+    }
+    radius[i] = (hi[i] - lo[i]) / 2;
+    mean += radius[i] / 3;
+  }
+
+  lsm303_calibration cal;
+  cal.magic = LSM303_CAL_MAGIC;
+  cal.version = LSM303_CAL_VERSION;
+  for (int i = 0; i < 3; i++) {
+    cal.offset[i] = (int16_t) ((hi[i] + lo[i]) / 2);
+    cal.scale[i] = (int16_t) (LSM303_CAL_ONE * mean / radius[i] + 0.5);
+  }
+  cal.check = calibration_check(&cal);
+  eeprom_update_block(&cal, (void *) LSM303_CAL_ADDRESS, sizeof(cal));
+
+  Serial.print("Saved offsets ");
+  for (int i = 0; i < 3; i++) { Serial.print(cal.offset[i]); Serial.print(" "); }
+  Serial.print("scales ");
+  for (int i = 0; i < 3; i++) { Serial.print(cal.scale[i]); Serial.print(" "); }
+  Serial.println();
+}
+
 void setup() {
   Serial.begin(9600);
   Wire.begin();
   compass.init();
   compass.enableDefault();
   compass.setMagGain(LSM303::magGain_47);
+  Serial.println("Turn the compass through every axis, then send s to save");
 }
 
 void loop() {  
   compass.read();
+
+  if (Serial.available() && Serial.read() == 's') {
+    save_calibration();
+  }
   
   running_min.x = min(running_min.x, compass.m.x);
   running_min.y = min(running_min.y, compass.m.y);
@@ -1,19 +1,28 @@
 #include "GTPA010.h"
 
+#include <util/atomic.h>
+
 #include "Sensors.h"
 #include "TinyGPS.h"
-#include "TimerThree.h"
 
 
 bool GTPA010::newData = 0;
 
 /* Static variable declarations */
-char GTPA010::dataBuffer;
 gpsData GTPA010::data;
+unsigned long int GTPA010::fixes = 0;
+unsigned long int GTPA010::baud = GPS_BAUD_RATE;
+
+// Receive ring buffer, filled by rxPoll() and drained by readData()
+volatile byte GTPA010::rxBuffer[GPS_RX_BUFFER_SIZE];
+volatile byte GTPA010::rxHead = 0;
+volatile byte GTPA010::rxTail = 0;
+volatile unsigned int GTPA010::rxOverflow = 0;
 
-// Inturupt values
-volatile bool GTPA010::gpsValue = -1;
-volatile bool GTPA010::gpsLock = 0;
+// Lock state, derived from the decoded sentences
+bool GTPA010::gpsLock = 0;
+unsigned long int GTPA010::lockStart = 0;
+unsigned long int GTPA010::lastFix = 0;
 
 gpsData* GTPA010::getData()
 {
@@ -29,63 +38,266 @@ void GTPA010::begin()
 {
 	// Start GPS - Defines in classes/Config.h
 	Serial2.begin(GPS_BAUD_RATE);
-	pinMode(GPS_FIX_PIN,INPUT);
 	pinMode(GPS_ENABLE_PIN,OUTPUT);
+	digitalWrite(GPS_ENABLE_PIN,HIGH);
 
+#if !FAKE_GPS_DATA && !REPLAY_GPS_DATA
+	// Talk to the module directly, before the receive interrupt takes over Serial2
+	configure();
 
-	// Setup GPS Interrupt check - Defines in classes/Config.h
-        Timer3.initialize(timer_ticks);
-	digitalWrite(GPS_ENABLE_PIN,HIGH);
-	Timer3.attachInterrupt(&gpsCheck);
+	// Timer0 already runs millis(), so piggyback on its compare A match to
+	// empty Serial2 about once a millisecond. The core's 64 byte buffer
+	// can then never overflow, however long loop() takes.
+	// Fake and replayed data never drain the ring, so it is left off.
+	OCR0A = 0xAF;
+	TIMSK0 |= _BV(OCIE0A);
+#endif
 }
 
-void GTPA010::gpsCheck()
+ISR(TIMER0_COMPA_vect)
 {
-	bool oldGpsValue = gpsValue; // check the old value for the 2D/3D lock pin
-	
-	gpsValue = digitalRead(GPS_FIX_PIN); // refresh value with a digitalRead
-	
-	if(!(oldGpsValue ^ gpsValue)) // Does the {new,old} value both 0?
-		gpsLock = 1; // Indicate a lock is present
-	else
-		gpsLock = 0; // Clear the lock variable
-	
-	sensorSecond = !sensorSecond; // Toggle the static sensor class variable for use of other sensors
+	GTPA010::rxPoll();
 }
 
-void GTPA010::readData()
+void GTPA010::rxPoll()
 {
-#if FAKE_GPS_DATA
-    GTPA010::fakeData();
-    return;
+	while (Serial2.available())
+	{
+		byte c = Serial2.read();
+		byte next = rxHead + 1; // Wraps at GPS_RX_BUFFER_SIZE
+
+		if (next == rxTail) // Full, drop the byte, the sentence will fail its checksum
+			rxOverflow++;
+		else
+		{
+			rxBuffer[rxHead] = c;
+			rxHead = next;
+		}
+	}
+}
+
+unsigned int GTPA010::rxOverflows()
+{
+	unsigned int count;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+	{
+		count = rxOverflow;
+	}
+	return count;
+}
+
+unsigned long int GTPA010::fixCount()
+{
+	return fixes;
+}
+
+unsigned long int GTPA010::baudRate()
+{
+	return baud;
+}
+
+/**
+ * Configure the module with PMTK commands. Each step falls back on its
+ * own: if the faster UART rate does not work we go back to the default
+ * rate and stay at 1 Hz, and a refused command just leaves that setting
+ * at its default.
+ */
+bool GTPA010::configure()
+{
+	char line[24];
+	bool ok = true;
+
+	// Make sure the module is up and talking before sending it anything
+	if (!readSentence(line, sizeof(line), GPS_CONFIG_TIMEOUT))
+		return false;
+
+	// PMTK251 is not acked, it takes effect straight away. Check it
+	// worked by listening for good sentences at the new rate.
+	char cmd[16];
+	sprintf(cmd, "PMTK251,%lu", (unsigned long) GPS_FAST_BAUD_RATE);
+	sendCommand(cmd);
+	Serial2.flush();
+	Serial2.begin(GPS_FAST_BAUD_RATE);
+	baud = GPS_FAST_BAUD_RATE;
+
+	if (!readSentence(line, sizeof(line), GPS_CONFIG_TIMEOUT))
+	{
+		// The module may have switched and only the check failed, so
+		// tell it to go back as well before following it
+		sprintf(cmd, "PMTK251,%lu", (unsigned long) GPS_BAUD_RATE);
+		sendCommand(cmd);
+		Serial2.flush();
+		Serial2.begin(GPS_BAUD_RATE);
+		baud = GPS_BAUD_RATE;
+		ok = false;
+	}
+
+	// Only GPRMC and GPGGA, once per fix
+	sendCommand("PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+	ok = waitAck("314") && ok;
+
+	// A faster fix rate only fits at the faster UART rate
+	if (baud == GPS_FAST_BAUD_RATE)
+	{
+		sprintf(cmd, "PMTK220,%u", (unsigned int) GPS_UPDATE_MS);
+		sendCommand(cmd);
+		ok = waitAck("220") && ok;
+	}
+
+#ifdef DEBUG_GPS
+	Serial.print("GPS configured at ");
+	Serial.print(baud);
+	Serial.println(ok ? " baud" : " baud, with fallbacks");
 #endif
-	if(gpsLock) // If we have a lock
+	return ok;
+}
+
+void GTPA010::sendCommand(const char *body)
+{
+	byte checksum = 0;
+	for (const char *p = body; *p; p++)
+		checksum ^= *p;
+
+	char tail[6];
+	sprintf(tail, "*%02X\r\n", checksum);
+
+	Serial2.print('$');
+	Serial2.print(body);
+	Serial2.print(tail);
+}
+
+bool GTPA010::readSentence(char *line, byte size, unsigned int timeout)
+{
+	unsigned long int start = millis();
+	byte len = 0;
+	byte checksum = 0;
+	bool in_sentence = false;
+
+	while (millis() - start < timeout)
 	{
-		while (Serial2.available()) // And while the Serial. is available
+		if (!Serial2.available())
+			continue;
+
+		char c = Serial2.read();
+		if (c == '$') // Start over on every sentence start
 		{
-			dataBuffer = Serial2.read(); // Read the available data
-				
-			if (gps.encode(dataBuffer)) // Did a new valid sentence come in?
-				newData = true; // Notify the class that there is new data to show!
+			in_sentence = true;
+			len = 0;
+			checksum = 0;
+		}
+		else if (!in_sentence)
+			continue;
+		else if (c == '*') // Two hex digits of checksum follow
+		{
+			char hex[3] = { 0, 0, 0 };
+			for (byte i = 0; i < 2 && millis() - start < timeout; )
+				if (Serial2.available())
+					hex[i++] = Serial2.read();
+
+			in_sentence = false;
+			if (strtol(hex, NULL, 16) == checksum)
+			{
+				line[len] = '\0';
+				return true;
+			}
 		}
-		
-		gps.get_position(&data.lat, &data.lon, &data.age); // Parse the position data
-		gps.crack_datetime(&data.year, &data.month, &data.day, &data.hour, &data.minute, &data.second, &data.hundredths, &data.age); // Parse the time data
-		
-		if(data.lat == TinyGPS::GPS_INVALID_ANGLE || data.lon == TinyGPS::GPS_INVALID_ANGLE || gps.satellites() == TinyGPS::GPS_INVALID_SATELLITES || gps.hdop() == TinyGPS::GPS_INVALID_HDOP) // If any component of this data is invalid, then cancel the new data decleration, and if enabled, print that the data is invalid across the serial
+		else
 		{
-			newData = false;
-			
-			#if SERIAL_PRINT_ENABLE
-			Serial.println("GPS DATA INVALID");
-			#endif
+			checksum ^= c;
+			if (len < size - 1) // Only the start of long sentences is kept
+				line[len++] = c;
 		}
-			
-	} else {
+	}
+	return false;
+}
+
+bool GTPA010::waitAck(const char *cmd)
+{
+	char line[24];
+	char ack[16];
+	sprintf(ack, "PMTK001,%s,3", cmd); // Flag 3 means the command succeeded
+
+	unsigned long int start = millis();
+	while (millis() - start < GPS_CONFIG_TIMEOUT)
+	{
+		if (!readSentence(line, sizeof(line), GPS_CONFIG_TIMEOUT))
+			return false;
+		if (!strcmp(line, ack))
+			return true;
+	}
+	return false;
+}
+
+unsigned long int GTPA010::lockTime()
+{
+	return lockStart;
+}
+
+unsigned long int GTPA010::lastFixTime()
+{
+	return lastFix;
+}
+
+void GTPA010::readData()
+{
+#if FAKE_GPS_DATA
+    GTPA010::fakeData();
+    return;
+#elif REPLAY_GPS_DATA
+	replayData();
+#else
+	// Decode everything that arrived since the last call. Only the last
+	// complete sentence matters, the ring buffer makes sure none were lost.
+	while (rxTail != rxHead)
+	{
+		char c = rxBuffer[rxTail];
+		rxTail++; // Wraps at GPS_RX_BUFFER_SIZE
+
+		if (gps.encode(c)) // Did a new valid sentence come in?
+			publish();
+	}
+#endif
+
+	// A GGA without a fix or with a poor HDOP drops the lock straight away,
+	// silence drops it after a while
+	if (gpsLock && (gps.fix_quality() == 0 || gps.hdop() > GPS_MAX_HDOP || millis() - lastFix > GPS_LOCK_TIMEOUT))
+		gpsLock = 0;
+
 #ifdef DEBUG_GPS
-            Serial.println("No lock!");
+	if (!gpsLock)
+		Serial.println("No lock!");
 #endif
-        }
+}
+
+void GTPA010::publish()
+{
+	gpsData fix = data;
+
+	gps.get_position(&fix.lat, &fix.lon, &fix.age); // Parse the position data
+	gps.crack_datetime(&fix.year, &fix.month, &fix.day, &fix.hour, &fix.minute, &fix.second, &fix.hundredths, &fix.age); // Parse the time data
+
+	if(fix.lat == TinyGPS::GPS_INVALID_ANGLE || fix.lon == TinyGPS::GPS_INVALID_ANGLE || gps.satellites() == TinyGPS::GPS_INVALID_SATELLITES || gps.hdop() == TinyGPS::GPS_INVALID_HDOP) // If any component of this data is invalid, keep the last good fix, and if enabled, print that the data is invalid across the serial
+	{
+		newData = false;
+
+		#if SERIAL_PRINT_ENABLE
+		Serial.println("GPS DATA INVALID");
+		#endif
+		return;
+	}
+
+	// Readers only ever see whole fixes, never a half copied one
+	data = fix;
+	fixes++;
+	newData = true;
+	lastFix = millis();
+
+	// Report the lock on the first good sentence that has one
+	if (!gpsLock && gps.fix_quality() > 0 && gps.hdop() <= GPS_MAX_HDOP)
+	{
+		gpsLock = 1;
+		lockStart = lastFix;
+	}
 }
 
 #if FAKE_GPS_DATA
@@ -93,6 +305,30 @@ void GTPA010::readData()
 
 int tstart_time = 0;
 
+// Where the trace has been decoded up to: the next byte of fd_stream, and
+// the index and position of the last point read
+static const uint8_t *fd_next;
+static int fd_index = -1;
+static long int fd_lat = 0;
+static long int fd_lon = 0;
+
+/**
+ * Read one zigzag varint change from the trace
+ */
+static long int fd_read_delta() {
+    unsigned long int z = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+
+    do {
+        b = pgm_read_byte(fd_next++);
+        z |= (unsigned long int) (b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+
+    return (long int) (z >> 1) ^ -(long int) (z & 1);
+}
+
 /**
  * Provide some fake data in case we are demoing in a location
  * where it is not possible to get a GPS fix
@@ -106,12 +342,163 @@ void GTPA010::fakeData() {
     // Calculate how far into the path we are
     int index = (Sensors::getTime() - tstart_time) % fd_len;
 
-    // Set the fake data
-    data.lat = fd_lat[index];
-    data.lon = fd_lon[index];
+    // The trace is only decoded forwards, so start again from the top
+    // when it wraps
+    if (index < fd_index) {
+        fd_index = -1;
+    }
+    if (fd_index < 0) {
+        fd_next = fd_stream;
+        fd_lat = 0;
+        fd_lon = 0;
+    }
+    while (fd_index < index) {
+        fd_lat += fd_read_delta();
+        fd_lon += fd_read_delta();
+        fd_index++;
+    }
+
+    // Set the fake data, counting a fix each time the trace moves on
+    if (data.lat != fd_lat || data.lon != fd_lon)
+        fixes++;
+    data.lat = fd_lat;
+    data.lon = fd_lon;
 
     newData = true;
 }
+#elif REPLAY_GPS_DATA
+#include <SD.h>
+
+static File replayFile; // The log, opened on the first readData() after the SD card is up
+static char replayLine[GPS_REPLAY_LINE_SIZE]; // The next sentence, held until it is due
+static byte replayLength = 0; // Length of the sentence in replayLine, 0 if none is held
+static long int replayStart = -1; // Log time of the first timed sentence, -1 until one is read
+static long int replayLast = 0; // Log time of the last timed sentence
+static long int replayDay = 0; // Added to the log times once the log passes midnight
+static unsigned long int replayClock = 0; // millis() when the first timed sentence of this pass through the log was due
+
+// Reads the next non-empty line of the log, with its line ending, into
+// replayLine. Returns false at the end of the log.
+static bool replayReadLine()
+{
+	replayLength = 0;
+	int c;
+	while ((c = replayFile.read()) >= 0)
+	{
+		if (c == '\r' || c == '\n')
+		{
+			if (replayLength == 0)
+				continue; // Blank line, or the other half of a CR LF
+			replayLine[replayLength++] = '\n'; // TinyGPS ends the sentence here
+			return true;
+		}
+		if (replayLength < GPS_REPLAY_LINE_SIZE - 1) // Overlong lines are cut, and fail their checksum
+			replayLine[replayLength++] = c;
+	}
+	if (replayLength == 0)
+		return false;
+	replayLine[replayLength++] = '\n'; // Last line without an ending
+	return true;
+}
+
+// The UTC time in the first field of the held sentence (GGA, RMC and
+// friends), in ms since midnight, or -1 if the sentence has none.
+static long int replaySentenceTime()
+{
+	byte i = 0;
+	while (i < replayLength && replayLine[i] != ',')
+		i++;
+	i++;
+	if (i + 6 > replayLength)
+		return -1;
+
+	const char *p = replayLine + i;
+	for (byte j = 0; j < 6; j++)
+		if (p[j] < '0' || p[j] > '9')
+			return -1;
+
+	long int hours = (p[0] - '0') * 10 + (p[1] - '0');
+	long int minutes = (p[2] - '0') * 10 + (p[3] - '0');
+	long int seconds = (p[4] - '0') * 10 + (p[5] - '0');
+	long int t = ((hours * 60 + minutes) * 60 + seconds) * 1000;
+
+	// Fractions of a second, down to ms
+	p += 6;
+	if (*p == '.')
+	{
+		p++;
+		for (int scale = 100; scale > 0 && *p >= '0' && *p <= '9'; scale /= 10)
+			t += (*p++ - '0') * scale;
+	}
+	return t;
+}
+
+/**
+ * Play back a recorded walk: every sentence in the log whose timestamp has
+ * come due, relative to the first one and scaled by GPS_REPLAY_SPEED, goes
+ * through the same decoder and publish() as live data. Sentences without a
+ * time (GSA, GSV) go out with the timed sentence before them. The log
+ * starts over when it runs out, a logged second after its last sentence.
+ */
+void GTPA010::replayData()
+{
+	if (!replayFile)
+	{
+		replayFile = SD.open(GPS_REPLAY_FILE);
+		if (!replayFile)
+			return; // No card yet, or no log on it
+		replayLength = 0;
+		replayStart = -1;
+		replayLast = 0;
+		replayDay = 0;
+	}
+
+	bool rewound = false;
+	while (true)
+	{
+		if (replayLength == 0 && !replayReadLine())
+		{
+			if (rewound)
+				return; // Nothing in the log at all
+			replayFile.seek(0);
+			if (replayStart >= 0)
+			{
+				// Carry on a second after the last sentence, as if the log went
+				// on, rather than cutting the last one short
+				replayClock += (replayLast + 1000 - replayStart) * 100 / GPS_REPLAY_SPEED;
+			}
+			replayLast = 0;
+			replayDay = 0;
+			rewound = true;
+			continue;
+		}
+
+		long int t = replaySentenceTime();
+		if (t >= 0)
+		{
+			t += replayDay;
+			if (t < replayLast - 43200000L) // Went back more than 12 hours, so it passed midnight
+			{
+				replayDay += 86400000L;
+				t += 86400000L;
+			}
+
+			if (replayStart < 0)
+			{
+				replayStart = t;
+				replayClock = millis();
+			}
+			else if ((long int) (millis() - replayClock) * GPS_REPLAY_SPEED / 100 < t - replayStart)
+				return; // Not due yet, keep it for the next call
+			replayLast = t;
+		}
+
+		for (byte i = 0; i < replayLength; i++)
+			if (gps.encode(replayLine[i]))
+				publish();
+		replayLength = 0;
+	}
+}
 #endif
 
 void GTPA010::printData()
@@ -124,8 +511,12 @@ void GTPA010::printData()
 		Serial.print(data.lon == TinyGPS::GPS_INVALID_ANGLE ? NAN : data.lon);
 	Serial.print(" SAT=");
 		Serial.print(gps.satellites() == TinyGPS::GPS_INVALID_SATELLITES ? NAN : gps.satellites());
+	Serial.print(" FIX=");
+		Serial.print(gps.fix_quality());
 	Serial.print(" PREC=");
 		Serial.print(gps.hdop() == TinyGPS::GPS_INVALID_HDOP ? NAN : gps.hdop());
+	Serial.print(" DROP=");
+		Serial.print(rxOverflows());
 	  
 	Serial.print(" DATE=");
 	  
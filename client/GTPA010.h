@@ -3,17 +3,33 @@
 
 #include "Sensors.h"
 #include "TinyGPS.h"
-#include "TimerThree.h"
 
 
 // GPS Setup
 //#define DEBUG_GPS
 
-#define GPS_FIX_PIN 11
 #define GPS_ENABLE_PIN 12
-#define GPS_BAUD_RATE 4800
+#define GPS_BAUD_RATE 4800 // Module default rate, and the fallback if configuration fails
+#define GPS_FAST_BAUD_RATE 38400 // Rate requested by configure(), 5 Hz RMC+GGA does not fit in 4800
+#define GPS_UPDATE_MS 200 // Fix interval requested by configure()
+#define GPS_CONFIG_TIMEOUT 1500 // How long to wait for a sentence or an ack while configuring, in ms
+#define GPS_MAX_HDOP 500 // Worst HDOP, in 100ths, that still counts as a lock
+#define GPS_LOCK_TIMEOUT 2000 // A lock is dropped if no good fix arrives for this long, in ms
+#define GPS_RX_BUFFER_SIZE 256 // Must be 256 so the byte sized ring indices wrap on their own
 
+#ifndef FAKE_GPS_DATA
 #define FAKE_GPS_DATA 1
+#endif
+
+// Replay a recorded NMEA log from the SD card through the real decoder
+// instead of listening to the module. FAKE_GPS_DATA takes precedence.
+// Both can be set from the command line, as the host build does.
+#ifndef REPLAY_GPS_DATA
+#define REPLAY_GPS_DATA 0
+#endif
+#define GPS_REPLAY_FILE "gpslog.txt" // Raw NMEA sentences, one per line, as logged from Serial2
+#define GPS_REPLAY_SPEED 100 // Replay rate in percent of the logged rate, 200 plays twice as fast
+#define GPS_REPLAY_LINE_SIZE 96 // Longest line kept, NMEA allows 82 characters
 
 typedef struct gpsData
 {
@@ -29,7 +45,7 @@ typedef struct gpsData
 	byte minute;
 	byte second;
 	byte hundredths;
-};
+} gpsData;
 
 class GTPA010 : Sensors
 {
@@ -40,21 +56,39 @@ public:
 	
 	#if FAKE_GPS_DATA
 	static void fakeData(); // Used in testing, designed to replicate GPS data for the purpose of validating other functions, not included in production class, defined in Config
+	#elif REPLAY_GPS_DATA
+	static void replayData(); // Feeds the sentences of the log on the SD card to the decoder as their timestamps come due
 	#endif
 	
 	static void begin(); // Begin sensor initilization routines
+	static bool configure(); // Raise the UART rate, fix rate and trim the sentences sent by the module, true if all of it was accepted
+	static unsigned long int baudRate(); // The rate Serial2 ended up at after configure()
+	static void rxPoll(); // Moves received bytes from Serial2 into the GPS ring buffer, called from the TIMER0_COMPA interrupt
+	static unsigned int rxOverflows(); // The number of received bytes dropped because the ring buffer was full
+	static unsigned long int fixCount(); // The number of fixes published since startup
 	static bool check(); // A validity check for the sensor, if true, its reporting a valid response, if false, then response is invalid
 	
-	static void gpsCheck(); // A function called by an inturput service to check GPS lock status
+	static unsigned long int lockTime(); // millis() when the current lock was acquired
+	static unsigned long int lastFixTime(); // millis() when the last good fix was decoded
 
-	static volatile bool gpsLock; // The indicator for a valid lock against a 2D/3D lock
+	static bool gpsLock; // The indicator for a valid lock, from the GGA fix quality and HDOP
 private:
 	static gpsData data; // Used to store the data in the gpsData struct
 	static bool newData; // A private variable determining if the data has been refreshed
-	static const long int timer_ticks = 1000000; // The length of ticks inbetween checks of the GPS, dependant on the devices clock speed
-	static char dataBuffer; // Char buffer for the inputed data
+	static unsigned long int fixes; // Count of fixes copied into data
+	static void publish(); // Copies a freshly decoded fix into data in one step
+
+	static unsigned long int baud; // Current Serial2 rate
+	static void sendCommand(const char *body); // Sends $<body>*<checksum> to the module
+	static bool readSentence(char *line, byte size, unsigned int timeout); // Reads the next sentence with a good checksum into line
+	static bool waitAck(const char *cmd); // Waits for the PMTK001 ack of the given command number
 
-	static volatile bool gpsValue; // The value read from the GPS 2D/3D fix pin
+	static volatile byte rxBuffer[GPS_RX_BUFFER_SIZE]; // Bytes received from the GPS, waiting to be decoded
+	static volatile byte rxHead; // Next slot written by rxPoll()
+	static volatile byte rxTail; // Next slot read by readData()
+	static volatile unsigned int rxOverflow; // Bytes dropped because rxBuffer was full
+	static unsigned long int lockStart; // When gpsLock was last set
+	static unsigned long int lastFix; // When the last good fix was decoded
 };
 
 #endif
@@ -2,6 +2,8 @@
 #include <LSM303.h>
 #include <Wire.h>
 #include <math.h>
+#include <avr/eeprom.h>
+#include "fixmath.h"
 
 // Defines ////////////////////////////////////////////////////////////////
 
@@ -11,8 +13,8 @@
 #define ACC_ADDRESS_SA0_A_LOW  (0x30 >> 1)
 #define ACC_ADDRESS_SA0_A_HIGH (0x32 >> 1)
 
-int past_headings[3] = {0, 0, 0};
-int past_heading_i = 0;
+// Extra fraction bits kept by the heading filter
+#define HEADING_FRAC 8
 
 // Constructors ////////////////////////////////////////////////////////////////
 
@@ -26,8 +28,27 @@ LSM303::LSM303(void)
   _device = LSM303_DEVICE_AUTO;
   acc_address = ACC_ADDRESS_SA0_A_LOW;
 
+  // Hard iron offsets measured on the original unit, used until the
+  // calibrate sketch has stored a record in EEPROM.
+  cal_offset[0] = -105; cal_offset[1] = 115; cal_offset[2] = 0;
+  cal_scale[0] = cal_scale[1] = cal_scale[2] = LSM303_CAL_ONE;
+  cal_loaded = false;
+  sample_hook = 0;
+
+  stat_req.status = TWI_REQ_IDLE;
+  acc_req.status = TWI_REQ_IDLE;
+  mag_req.status = TWI_REQ_IDLE;
+  poll_time = 0;
+  sample_head = sample_tail = 0;
+  samples_dropped = 0;
+
   io_timeout = 0;  // 0 = no timeout
   did_timeout = false;
+
+  last_heading = 0;
+  filt_primed = false;
+  filt_angle = 0;
+  setHeadingFilter(2, 45, 3);
 }
 
 // Public Methods //////////////////////////////////////////////////////////////
@@ -81,25 +102,91 @@ void LSM303::init(byte device, byte sa0_a)
         _device = (readMagReg(LSM303_WHO_AM_I_M) == 0x3C) ? LSM303DLM_DEVICE : LSM303DLH_DEVICE;
       }
   }
+
+  loadCalibration();
+}
+
+// Checksum over a calibration record, excluding the check byte itself
+static uint8_t calibrationCheck(const lsm303_calibration *cal)
+{
+  const uint8_t *p = (const uint8_t *) cal;
+  uint8_t sum = 0;
+  for (byte i = 0; i < sizeof(*cal) - 1; i++) sum += p[i];
+  return ~sum;
+}
+
+// Loads the calibration record from EEPROM.  Returns false, and leaves the
+// current calibration alone, if the record is missing, corrupt, or from a
+// different version.
+bool LSM303::loadCalibration(void)
+{
+  lsm303_calibration cal;
+
+  eeprom_read_block(&cal, (const void *) LSM303_CAL_ADDRESS, sizeof(cal));
+  if (cal.magic != LSM303_CAL_MAGIC || cal.version != LSM303_CAL_VERSION
+      || cal.check != calibrationCheck(&cal))
+    return false;
+
+  setCalibration(&cal);
+  cal_loaded = true;
+  return true;
+}
+
+// Stores the current calibration in EEPROM.  Bytes that have not changed
+// are not rewritten.
+void LSM303::saveCalibration(void)
+{
+  lsm303_calibration cal;
+
+  getCalibration(&cal);
+  eeprom_update_block(&cal, (void *) LSM303_CAL_ADDRESS, sizeof(cal));
+}
+
+void LSM303::getCalibration(lsm303_calibration *cal)
+{
+  cal->magic = LSM303_CAL_MAGIC;
+  cal->version = LSM303_CAL_VERSION;
+  for (byte i = 0; i < 3; i++)
+  {
+    cal->offset[i] = cal_offset[i];
+    cal->scale[i] = cal_scale[i];
+  }
+  cal->check = calibrationCheck(cal);
+}
+
+void LSM303::setCalibration(const lsm303_calibration *cal)
+{
+  for (byte i = 0; i < 3; i++)
+  {
+    cal_offset[i] = cal->offset[i];
+    cal_scale[i] = cal->scale[i];
+  }
 }
 
 // Turns on the LSM303's accelerometer and magnetometers and places them in normal
 // mode.
 void LSM303::enableDefault(void)
 {
-  // Enable Accelerometer
-  // 0x27 = 0b00100111
-  // Normal power mode, all axes enabled
-  writeAccReg(LSM303_CTRL_REG1_A, 0x27);
-
+  // Enable Accelerometer at LSM303_ACC_HZ, all axes enabled, with block
+  // data update so the two bytes of an axis always come from one sample
   if (_device == LSM303DLHC_DEVICE)
-    writeAccReg(LSM303_CTRL_REG4_A, 0x08); // DLHC: enable high resolution mode
+  {
+    // 0x47 = 0b01000111: 50 Hz, normal power mode
+    writeAccReg(LSM303_CTRL_REG1_A, 0x47);
+    writeAccReg(LSM303_CTRL_REG4_A, 0x88); // BDU, high resolution mode
+  }
+  else
+  {
+    // 0x27 = 0b00100111: normal power mode, 50 Hz
+    writeAccReg(LSM303_CTRL_REG1_A, 0x27);
+    writeAccReg(LSM303_CTRL_REG4_A, 0x80); // BDU
+  }
 
   // Enable Magnetometer
   // 0x00 = 0b00000000
   // Continuous conversion mode
   writeMagReg(LSM303_MR_REG_M, 0x00);
-  writeMagReg(LSM303_CRA_REG_M, 0x14);  // 0x14 = mag 30Hz output rate
+  writeMagReg(LSM303_CRA_REG_M, 0x14);  // 0x14 = mag 30Hz (LSM303_MAG_HZ) output rate
 }
 
 // Writes an accelerometer register
@@ -196,25 +283,20 @@ void LSM303::readAcc(void)
     }
   }
   
-  /* Old Wire.Reads(). Going to swap all y and z here */
-  
-  byte xla = Wire.read();
-  byte xha = Wire.read();
-  byte yla = Wire.read();
-  byte yha = Wire.read();
-  byte zla = Wire.read();
-  byte zha = Wire.read();
-   
-  
-  //New wire reads. Don't really work 
-  /*
-  byte xla = Wire.read();
-  byte xha = Wire.read();
-  byte zla = Wire.read();
-  byte zha = Wire.read();
-  byte yla = Wire.read();
-  byte yha = Wire.read();
-  */
+  byte buf[6];
+  for (byte i = 0; i < 6; i++) buf[i] = Wire.read();
+  decodeAcc(buf);
+}
+
+// Stores the 6 accelerometer output bytes, OUT_X_L_A first, in vector a
+void LSM303::decodeAcc(const byte *buf)
+{
+  byte xla = buf[0];
+  byte xha = buf[1];
+  byte yla = buf[2];
+  byte yha = buf[3];
+  byte zla = buf[4];
+  byte zha = buf[5];
   
   // combine high and low bytes, then shift right to discard lowest 4 bits (which are meaningless)
   // GCC performs an arithmetic right shift for signed negative numbers, but this code will not work
@@ -241,27 +323,34 @@ void LSM303::readMag(void)
     }
   }
 
-  uint16_t xhm = Wire.read();
-  uint16_t xlm = Wire.read();
+  byte buf[6];
+  for (byte i = 0; i < 6; i++) buf[i] = Wire.read();
+  decodeMag(buf);
+}
+
+// Stores the 6 magnetometer output bytes, OUT_X_H_M first, in vector m
+void LSM303::decodeMag(const byte *buf)
+{
+  uint16_t xhm = buf[0];
+  uint16_t xlm = buf[1];
 
   uint16_t yhm, ylm, zhm, zlm;
 
   if (_device == LSM303DLH_DEVICE)
   {
     // DLH: register address for Y comes before Z
-    yhm = Wire.read();
-    ylm = Wire.read();
-    zhm = Wire.read();
-    zlm = Wire.read();
+    yhm = buf[2];
+    ylm = buf[3];
+    zhm = buf[4];
+    zlm = buf[5];
   }
   else
   {
     // DLM, DLHC: register address for Z comes before Y
-    zhm = Wire.read();
-    zlm = Wire.read();
-    yhm = Wire.read();
-    ylm = Wire.read();
-
+    zhm = buf[2];
+    zlm = buf[3];
+    yhm = buf[4];
+    ylm = buf[5];
   }
 
 
@@ -286,56 +375,231 @@ void LSM303::read(void)
   readMag();
 }
 
-// Returns a heading in degrees, compensated for pitch and roll
-int LSM303::heading(void)
+// Queues a register read on the I2C bus
+static void queueRead(twi_request *req, byte address, byte reg, byte *buf, byte length)
 {
-    //Need to normalize the vector so that trig isn't broken
-    vector b = a;
-    vector_normalize(&b);
-    
-    float pitch = asin(-b.x);
-    float roll = asin(b.y/cos(pitch));
+  req->address = address;
+  req->reg = reg;
+  req->data = buf;
+  req->length = length;
+  if (twi_submitRead(req) != 0) req->status = TWI_REQ_ERROR;
+}
 
-    
-    float xh = (m.x+75+30) * cos(pitch) + m.z * sin(pitch);
-    float yh = (m.x+105) * sin(roll) * sin(pitch)
-        + (m.y-115) * cos(roll) - m.z * sin(roll) * cos(pitch);
-    float zh = -(m.x+105) * cos(roll) * sin(pitch) + (m.y-115) * sin(roll)
-        + m.z * cos(roll) * cos(pitch);
+// Moves the data-ready sampling along, without waiting for the bus:
+//   every LSM303_POLL_MS read SR_REG_M;
+//   when it shows new data, read STATUS_REG_A and the accelerometer
+//   outputs, and the magnetometer outputs;
+//   when those are in, store a sample.
+// The accelerometer runs faster than the magnetometer, so its reading is
+// normally new too.  If ZYXDA says it is not, the previous one is used.
+void LSM303::poll(void)
+{
+  if (stat_req.status == TWI_REQ_PENDING || acc_req.status == TWI_REQ_PENDING
+      || mag_req.status == TWI_REQ_PENDING)
+  {
+    // A hung bus would otherwise keep the reads in flight for good, so
+    // they always time out, after LSM303_READ_TIMEOUT if none is set.
+    unsigned int limit = io_timeout > 0 ? io_timeout : LSM303_READ_TIMEOUT;
+    if (((unsigned int)millis() - req_start) > limit)
+    {
+      twi_cancelRead(&stat_req);
+      twi_cancelRead(&acc_req);
+      twi_cancelRead(&mag_req);
+      stat_req.status = TWI_REQ_IDLE;
+      acc_req.status = TWI_REQ_IDLE;
+      mag_req.status = TWI_REQ_IDLE;
+      did_timeout = true;
+      last_status = LSM303_STATUS_TIMEOUT;
+    }
+    return;
+  }
 
-    int heading = (int)(180 * atan2(yh, xh)/PI) % 360;
-    
-    // Populate some fields for average heading calculation
-    if (!past_headings[0]) past_headings[0] = heading;
-    if (!past_headings[1]) past_headings[1] = heading;
-    if (!past_headings[2]) past_headings[2] = heading;
-    past_headings[past_heading_i] = heading;
-    past_heading_i = (past_heading_i + 1) % 3;
+  if (acc_req.status != TWI_REQ_IDLE || mag_req.status != TWI_REQ_IDLE)
+  {
+    did_timeout = acc_req.status != TWI_REQ_DONE || mag_req.status != TWI_REQ_DONE;
+    last_status = did_timeout ? 4 : 0;
+    if (!did_timeout)
+    {
+      if (acc_buf[0] & LSM303_ZYXDA_A) decodeAcc(acc_buf + 1);
+      decodeMag(mag_buf);
+      pushSample();
+    }
+    acc_req.status = TWI_REQ_IDLE;
+    mag_req.status = TWI_REQ_IDLE;
+  }
+
+  if (stat_req.status != TWI_REQ_IDLE)
+  {
+    bool ready = stat_req.status == TWI_REQ_DONE && (stat_buf[0] & LSM303_DRDY_M);
+    did_timeout = stat_req.status != TWI_REQ_DONE;
+    last_status = did_timeout ? 4 : 0;
+    stat_req.status = TWI_REQ_IDLE;
+    if (ready)
+    {
+      data_time = millis();
+      req_start = data_time;
+      queueRead(&acc_req, acc_address, LSM303_STATUS_REG_A | (1 << 7), acc_buf, 7);
+      queueRead(&mag_req, MAG_ADDRESS, LSM303_OUT_X_H_M, mag_buf, 6);
+      return;
+    }
+  }
+
+  if ((unsigned long)(millis() - poll_time) >= LSM303_POLL_MS)
+  {
+    poll_time = millis();
+    req_start = poll_time;
+    queueRead(&stat_req, MAG_ADDRESS, LSM303_SR_REG_M, stat_buf, 1);
+  }
+}
+
+// Adds the current a and m to the sample ring
+void LSM303::pushSample(void)
+{
+  byte next = (sample_head + 1) % LSM303_SAMPLES;
+  if (next == sample_tail)
+  {
+    sample_tail = (sample_tail + 1) % LSM303_SAMPLES;
+    samples_dropped++;
+  }
+
+  sample *s = &samples[sample_head];
+  s->time = data_time;
+  s->ax = a.x; s->ay = a.y; s->az = a.z;
+  s->mx = m.x; s->my = m.y; s->mz = m.z;
+  sample_head = next;
+}
+
+// Takes the oldest sample out of the ring; returns false if it is empty
+bool LSM303::readSample(sample *s)
+{
+  if (sample_tail == sample_head) return false;
+  *s = samples[sample_tail];
+  sample_tail = (sample_tail + 1) % LSM303_SAMPLES;
+  return true;
+}
+
+// Runs the samples taken since the last call through the heading filter,
+// so the filter sees them at the sensor's rate however often this is
+// called.  Returns the heading in degrees, compensated for pitch and roll.
+// If there are no new samples the previous heading is kept.
+int LSM303::update(void)
+{
+    sample s;
+
+    poll();
+    while (readSample(&s))
+    {
+        if (sample_hook) sample_hook(&s);
+        last_heading = tiltHeading(&s);
+    }
+    return last_heading;
+}
+
+// Computes the tilt-compensated field for one sample and feeds it to the
+// heading filter.  Returns the filtered heading in degrees.
+int LSM303::tiltHeading(const sample *s)
+{
+    // Readings are whole numbers, so work in integers.  Software float
+    // trig costs thousands of cycles per call on the AVR.
+    int32_t ax = s->ax, ay = s->ay, az = s->az;
+    int32_t mx = ((int32_t) (s->mx - cal_offset[0]) * cal_scale[0]) >> LSM303_CAL_SHIFT;
+    int32_t my = ((int32_t) (s->my - cal_offset[1]) * cal_scale[1]) >> LSM303_CAL_SHIFT;
+    int32_t mz = ((int32_t) (s->mz - cal_offset[2]) * cal_scale[2]) >> LSM303_CAL_SHIFT;
+
+    // The sines and cosines of pitch and roll follow directly from the
+    // gravity vector, without the angles themselves:
+    //   pitch = asin(-ax/g), roll = asin(ay/(g*cos(pitch)))
+    int32_t c = fix_isqrt32(ay*ay + az*az);
+    int32_t g = fix_isqrt32(ax*ax + ay*ay + az*az);
+    if (g == 0) g = 1;
+
+    int32_t sin_p = -ax * FIX_ONE / g;
+    int32_t cos_p = c * FIX_ONE / g;
+    int32_t sin_r = 0, cos_r = FIX_ONE;
+    if (c != 0) {
+        sin_r = ay * FIX_ONE / c;
+        cos_r = (az < 0 ? -az : az) * FIX_ONE / c;
+    }
+
+    // Magnetic field in the horizontal plane, scaled by FIX_ONE.  The
+    // products of sines stay Q14 so a weak horizontal field keeps its
+    // fraction bits.
+    int32_t sin_r_sin_p = (sin_r * sin_p) >> FIX_SHIFT;
+    int32_t sin_r_cos_p = (sin_r * cos_p) >> FIX_SHIFT;
+    int32_t xh = mx * cos_p + mz * sin_p;
+    int32_t yh = mx * sin_r_sin_p + my * cos_r - mz * sin_r_cos_p;
+
+    int heading = filterHeading(xh, yh);
 
     /* Debugging output. */
 #ifdef DEBUG_COMPASS
-    Serial.print("b.x");
-    Serial.print(b.x);
-    Serial.print("b.y");
-    Serial.print(b.y);
+    Serial.print("sin(pitch): ");
+    Serial.print(sin_p);
+    Serial.print(" sin(roll): ");
+    Serial.print(sin_r);
     Serial.println();
-    Serial.print("Pitch: ");
-    Serial.print(pitch);
-    Serial.print("Roll:");
-    Serial.print(roll);
     Serial.print("Xh: ");
     Serial.print(xh);
     Serial.print("Yh: ");
     Serial.print(yh);
-    Serial.print("Zh: ");
-    Serial.print(zh);
     
     Serial.print("Heading: ");
     Serial.println(heading);
 #endif
 
-    // Return average of most three recent headings
-    return ((int)(past_headings[0] + past_headings[1] + past_headings[2])/3) % 360;
+    return heading;
+}
+
+void LSM303::setHeadingFilter(byte shift, byte outlier_deg, byte max_outliers)
+{
+    filt_shift = shift;
+    filt_outlier = (int16_t) outlier_deg * FIX_DEG;
+    filt_max_outliers = max_outliers;
+    filt_outliers = 0;
+}
+
+// Feeds one horizontal field vector to the heading filter and returns the
+// filtered heading in degrees.  Averaging the vector rather than the angle
+// means headings either side of north do not average out to south.
+int LSM303::filterHeading(int32_t xh, int32_t yh)
+{
+    // Scale to a unit vector so strong and weak samples weigh the same
+    while ((xh < 0 ? -xh : xh) >= 0x8000 || (yh < 0 ? -yh : yh) >= 0x8000) {
+        xh /= 2;
+        yh /= 2;
+    }
+    int32_t norm = fix_isqrt32(xh*xh + yh*yh);
+    if (norm == 0) return filt_angle / FIX_DEG;
+
+    int32_t ux = xh * FIX_ONE / norm * (1 << HEADING_FRAC);
+    int32_t uy = yh * FIX_ONE / norm * (1 << HEADING_FRAC);
+
+    if (filt_primed) {
+        int16_t diff = fix_atan2(yh, xh) - filt_angle;
+        if (diff > 180 * FIX_DEG) diff -= 360 * FIX_DEG;
+        if (diff < -180 * FIX_DEG) diff += 360 * FIX_DEG;
+
+        if (diff <= filt_outlier && diff >= -filt_outlier) {
+            filt_x += (ux - filt_x) >> filt_shift;
+            filt_y += (uy - filt_y) >> filt_shift;
+            filt_outliers = 0;
+        } else if (filt_outliers < filt_max_outliers) {
+            filt_outliers++;
+            return filt_angle / FIX_DEG;
+        } else {
+            // Not a glitch, the heading really changed
+            filt_primed = false;
+        }
+    }
+    if (!filt_primed) {
+        filt_x = ux;
+        filt_y = uy;
+        filt_outliers = 0;
+        filt_primed = true;
+    }
+
+    filt_angle = fix_atan2(filt_y, filt_x);
+    return filt_angle / FIX_DEG;
 }
 
 void LSM303::vector_cross(const vector *a,const vector *b, vector *out)
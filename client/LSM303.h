@@ -3,6 +3,10 @@
 
 #include <Arduino.h> // for byte data type
 
+extern "C" {
+  #include "twi.h"    // for queued reads
+}
+
 // device types
 
 #define LSM303DLH_DEVICE   0
@@ -90,6 +94,39 @@
 #define LSM303DLHC_OUT_Y_H_M     0x07
 #define LSM303DLHC_OUT_Y_L_M     0x08
 
+// status bits
+
+#define LSM303_ZYXDA_A           0x08 // STATUS_REG_A: new X, Y and Z data
+#define LSM303_DRDY_M            0x01 // SR_REG_M: new data
+
+// sampling set up by enableDefault() and run by poll()
+
+#define LSM303_ACC_HZ            50   // accelerometer output data rate
+#define LSM303_MAG_HZ            30   // magnetometer output data rate
+#define LSM303_POLL_MS           5    // how often to check SR_REG_M
+#define LSM303_SAMPLES           8    // sample ring length
+#define LSM303_READ_TIMEOUT      20   // ms a queued read may take if no
+                                      // timeout has been set
+#define LSM303_STATUS_TIMEOUT    5    // last_status after a queued read
+                                      // was given up on
+
+// magnetometer calibration record, kept in EEPROM by the calibrate sketch
+
+#define LSM303_CAL_ADDRESS       0      // EEPROM address of the record
+#define LSM303_CAL_MAGIC         0x4D43 // "CM"
+#define LSM303_CAL_VERSION       1
+#define LSM303_CAL_SHIFT         8
+#define LSM303_CAL_ONE           (1 << LSM303_CAL_SHIFT) // scale of 1.0
+
+typedef struct
+{
+  uint16_t magic;
+  uint8_t version;
+  int16_t offset[3];  // hard iron: subtracted from the raw x, y, z
+  int16_t scale[3];   // soft iron: then multiplied by scale / LSM303_CAL_ONE
+  uint8_t check;      // ~(sum of the bytes above)
+} lsm303_calibration;
+
 class LSM303
 {
   public:
@@ -98,12 +135,20 @@ class LSM303
       float x, y, z;
     } vector;
 
+    typedef struct sample
+    {
+      unsigned long time; // millis() when the magnetometer had new data
+      int16_t ax, ay, az;
+      int16_t mx, my, mz;
+    } sample;
+
     vector a; // accelerometer readings
     vector m; // magnetometer readings
     vector m_max; // maximum magnetometer values, used for calibration
     vector m_min; // minimum magnetometer values, used for calibration
 
-    byte last_status; // status of last I2C transmission
+    byte last_status; // status of last I2C transmission, as from
+                      // Wire.endTransmission(), or LSM303_STATUS_TIMEOUT
     
     // HEX  = BIN          RANGE    GAIN X/Y/Z        GAIN Z
     //                               DLH (DLM/DLHC)    DLH (DLM/DLHC)
@@ -135,12 +180,46 @@ class LSM303
     void readMag(void);
     void read(void);
 
+    // Data-ready sampling: poll() checks the magnetometer's data-ready bit
+    // with queued I2C reads and fetches each new sample once, along with
+    // the latest accelerometer reading.  It never waits for the bus.
+    // Samples go into a ring of LSM303_SAMPLES; readSample() takes out the
+    // oldest.  If the ring is full the oldest sample is dropped.
+    void poll(void);
+    bool readSample(sample *s);
+    unsigned int droppedSamples(void) { return samples_dropped; }
+
+    // Magnetometer calibration.  init() loads the record from EEPROM, or
+    // keeps the built in defaults if there is no valid record.
+    bool loadCalibration(void);
+    void saveCalibration(void);
+    void getCalibration(lsm303_calibration *cal);
+    void setCalibration(const lsm303_calibration *cal);
+    bool calibrationLoaded(void) { return cal_loaded; }
+
     void setTimeout(unsigned int timeout);
     unsigned int getTimeout(void);
     bool timeoutOccurred(void);
     
-    int heading(void);
+    // update() polls the sensors and runs every new sample through the
+    // heading filter.  heading() returns the heading from the last
+    // update(), so every consumer in a tick sees the same value.
+    int update(void);
+    int heading(void) { return last_heading; }
+
+    // the same heading before it is cut to whole degrees, in FIX_DEG units
+    int16_t headingFine(void) { return filt_angle; }
+
+    // hook called by update() with every new sample, before the heading
+    // filter sees it
+    void setSampleHook(void (*hook)(const sample *s)) { sample_hook = hook; }
     int heading(vector from);
+
+    // Heading filter: exponential average of the unit field vector with a
+    // time constant of about 2^shift samples.  A sample more than
+    // outlier_deg away from the average is dropped, unless max_outliers
+    // in a row have been dropped, in which case the filter restarts there.
+    void setHeadingFilter(byte shift, byte outlier_deg, byte max_outliers);
     
     // vector functions
     static void vector_cross(const vector *a, const vector *b, vector *out);
@@ -152,8 +231,40 @@ class LSM303
     byte acc_address;
     unsigned int io_timeout;
     bool did_timeout;
+
+    int16_t cal_offset[3];
+    int16_t cal_scale[3];   // LSM303_CAL_ONE = 1.0
+    bool cal_loaded;        // true if the calibration came from EEPROM
+
+    void (*sample_hook)(const sample *s);
+
+    int last_heading;       // degrees, from the last update()
+    int32_t filt_x, filt_y; // averaged unit field vector, Q14 << HEADING_FRAC
+    int16_t filt_angle;     // heading of filt_x/filt_y, FIX_DEG units
+    bool filt_primed;       // false until the first sample
+    byte filt_shift;
+    int16_t filt_outlier;   // FIX_DEG units
+    byte filt_max_outliers;
+    byte filt_outliers;     // consecutive samples dropped
+    
+    twi_request stat_req, acc_req, mag_req;
+    byte stat_buf[1];
+    byte acc_buf[7];        // STATUS_REG_A, then the output registers
+    byte mag_buf[6];
+    unsigned int req_start; // millis() when the pending read was queued
+    unsigned long poll_time;
+    unsigned long data_time;
+
+    sample samples[LSM303_SAMPLES];
+    byte sample_head, sample_tail;
+    unsigned int samples_dropped;
     
     byte detectSA0_A(void);
+    void decodeAcc(const byte *buf);
+    void decodeMag(const byte *buf);
+    void pushSample(void);
+    int tiltHeading(const sample *s);
+    int filterHeading(int32_t xh, int32_t yh);
 };
 
 #endif
@@ -3,9 +3,6 @@
 // Static allocations
 unsigned long int Sensors::time;
 
-// Prepare the inturupt element
-volatile bool Sensors::sensorSecond = 0;
-
 Sensors::Sensors()
 {
 	Wire.begin(); // Start the wire interface
@@ -33,12 +30,9 @@ void Sensors::writeTo(int destination, byte address, byte val) {
 void Sensors::readFrom(int destination, byte address, int num, byte _buff[]) {
 	Wire.beginTransmission(destination); // start transmission to device 
 	Wire.write(address);             // sends address to read from
-	Wire.endTransmission();         // end transmission
-	
-	delay(6);
+	Wire.endTransmission(false);    // repeated start, keep the bus for the read
 	
-	Wire.beginTransmission(destination); // start transmission to device
-	Wire.requestFrom(destination, num);    // request 6 bytes from device
+	Wire.requestFrom(destination, num);    // request num bytes from device
 	
 	int i = 0;
 	while(Wire.available())         // device may send less than requested (abnormal)
@@ -46,6 +40,4 @@ void Sensors::readFrom(int destination, byte address, int num, byte _buff[]) {
 		_buff[i] = Wire.read();    // receive a byte
 		i++;
 	}
-	
-	Wire.endTransmission();         // end transmission
 }
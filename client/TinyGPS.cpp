@@ -35,6 +35,7 @@ TinyGPS::TinyGPS()
   ,  _course(GPS_INVALID_ANGLE)
   ,  _hdop(GPS_INVALID_HDOP)
   ,  _numsats(GPS_INVALID_SATELLITES)
+  ,  _fix_quality(0)
   ,  _last_time_fix(GPS_INVALID_FIX_TIME)
   ,  _last_position_fix(GPS_INVALID_FIX_TIME)
   ,  _parity(0)
@@ -43,6 +44,9 @@ TinyGPS::TinyGPS()
   ,  _term_number(0)
   ,  _term_offset(0)
   ,  _gps_data_good(false)
+#ifdef _GPS_SENTENCE_FILTER
+  ,  _skip_sentence(false)
+#endif
 #ifndef _GPS_NO_STATS
   ,  _encoded_characters(0)
   ,  _good_sentences(0)
@@ -62,6 +66,11 @@ bool TinyGPS::encode(char c)
 
 #ifndef _GPS_NO_STATS
   ++_encoded_characters;
+#endif
+#ifdef _GPS_SENTENCE_FILTER
+  // sentence we don't decode, wait for the next one
+  if (_skip_sentence && c != '$')
+    return valid_sentence;
 #endif
   switch(c)
   {
@@ -86,6 +95,10 @@ bool TinyGPS::encode(char c)
     _sentence_type = _GPS_SENTENCE_OTHER;
     _is_checksum_term = false;
     _gps_data_good = false;
+    _new_fix_quality = 0;
+#ifdef _GPS_SENTENCE_FILTER
+    _skip_sentence = false;
+#endif
     return valid_sentence;
   }
 
@@ -168,6 +181,10 @@ bool TinyGPS::term_complete()
     byte checksum = 16 * from_hex(_term[0]) + from_hex(_term[1]);
     if (checksum == _parity)
     {
+      // keep the quality of every good GPGGA, so a lost fix shows up at once
+      if (_sentence_type == _GPS_SENTENCE_GPGGA)
+        _fix_quality = _new_fix_quality;
+
       if (_gps_data_good)
       {
 #ifndef _GPS_NO_STATS
@@ -216,6 +233,18 @@ bool TinyGPS::term_complete()
       _sentence_type = _GPS_SENTENCE_GPGGA;
     else
       _sentence_type = _GPS_SENTENCE_OTHER;
+#ifdef _GPS_SENTENCE_FILTER
+    byte accept = 0;
+    if (_sentence_type == _GPS_SENTENCE_GPRMC)
+      accept = _GPS_ACCEPT_GPRMC;
+    else if (_sentence_type == _GPS_SENTENCE_GPGGA)
+      accept = _GPS_ACCEPT_GPGGA;
+    if (!(accept & (_GPS_SENTENCE_FILTER)))
+    {
+      _sentence_type = _GPS_SENTENCE_OTHER;
+      _skip_sentence = true;
+    }
+#endif
     return false;
   }
 
@@ -260,6 +289,7 @@ bool TinyGPS::term_complete()
       break;
     case COMBINE(_GPS_SENTENCE_GPGGA, 6): // Fix data (GPGGA)
       _gps_data_good = _term[0] > '0';
+      _new_fix_quality = _gps_data_good ? _term[0] - '0' : 0;
       break;
     case COMBINE(_GPS_SENTENCE_GPGGA, 7): // Satellites used (GPGGA)
       _new_numsats = (unsigned char)atoi(_term);
@@ -37,6 +37,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
 #define _GPS_KM_PER_METER 0.001
 // #define _GPS_NO_STATS
 
+// The sentences to decode, as a sum of _GPS_ACCEPT_ bits.  Only GPRMC and
+// GPGGA carry anything we use; GPGGA adds the altitude, HDOP, satellites
+// and fix quality.  Any other sentence is dropped as soon as its type term
+// is complete, and the rest of its characters are not copied or
+// checksummed.  Define _GPS_NO_SENTENCE_FILTER to run every sentence
+// through the parser.
+#define _GPS_ACCEPT_GPGGA 0x01
+#define _GPS_ACCEPT_GPRMC 0x02
+#if !defined(_GPS_NO_SENTENCE_FILTER) && !defined(_GPS_SENTENCE_FILTER)
+#define _GPS_SENTENCE_FILTER (_GPS_ACCEPT_GPRMC | _GPS_ACCEPT_GPGGA)
+#endif
+
 class TinyGPS
 {
 public:
@@ -75,6 +87,10 @@ public:
   // horizontal dilution of precision in 100ths
   inline unsigned long hdop() { return _hdop; }
 
+  // fix quality in last GPGGA sentence, 0 = no fix, 1 = GPS, 2 = DGPS, ...
+  // updated even by sentences without a fix
+  inline byte fix_quality() { return _fix_quality; }
+
   void f_get_position(float *latitude, float *longitude, unsigned long *fix_age = 0);
   void crack_datetime(int *year, byte *month, byte *day, 
     byte *hour, byte *minute, byte *second, byte *hundredths = 0, unsigned long *fix_age = 0);
@@ -108,6 +124,7 @@ private:
   unsigned long  _course, _new_course;
   unsigned long  _hdop, _new_hdop;
   unsigned short _numsats, _new_numsats;
+  byte _fix_quality, _new_fix_quality;
 
   unsigned long _last_time_fix, _new_time_fix;
   unsigned long _last_position_fix, _new_position_fix;
@@ -120,6 +137,9 @@ private:
   byte _term_number;
   byte _term_offset;
   bool _gps_data_good;
+#ifdef _GPS_SENTENCE_FILTER
+  bool _skip_sentence;
+#endif
 
 #ifndef _GPS_NO_STATS
   // statistics
@@ -0,0 +1,106 @@
+#include <Arduino.h>
+
+#include "autozoom.h"
+#include "fixmath.h"
+#include "TinyGPS.h"
+
+// the next turn has to be within this many pixels of the dot, a bit over a
+// third of the screen width, to be on the screen wherever the window is
+const uint16_t autozoom_turn_px = 48;
+
+// a turn only counts as the next one while it is within this many seconds
+// of travel, or within autozoom_turn_near_m
+const uint32_t autozoom_turn_secs = 60;
+const uint32_t autozoom_turn_near_m = 200;
+
+// zoom in only when the more detailed map is under this much of the
+// limits, in 256ths; it leaves the current map at under 3/8 of them
+const uint32_t autozoom_in_load = 192;
+
+// smoothed ground speed, in mm/s
+static uint32_t speed_mm_s = 0;
+static uint8_t have_speed = 0;
+
+// millis() at the last change of map
+static uint32_t last_change = 0;
+
+void autozoom_speed(uint32_t speed) {
+    if (speed == TinyGPS::GPS_INVALID_SPEED) {
+        return;
+    }
+
+    // 1/100 knot is 5.144 mm/s; nothing on foot or a bike goes 1000 knots
+    uint32_t mm_s = min(speed, 100000UL) * 5144 / 1000;
+    if (!have_speed) {
+        speed_mm_s = mm_s;
+        have_speed = 1;
+    } else {
+        speed_mm_s = (3 * speed_mm_s + mm_s) / 4;
+    }
+}
+
+// The size of a pixel on a map, in mm, from the height of the map.  1e-5
+// degrees of latitude is 1.1132 m.
+static uint32_t map_mm_per_px(uint8_t map_num) {
+    return (uint32_t) (map_box[map_num].N - map_box[map_num].S)
+        * 11132 / 10 / ((uint32_t) map_y_limit[map_num] + 1);
+}
+
+// The distance between two positions, in m.  A degree of longitude is a
+// degree of latitude times the cosine of the latitude.  Anything over
+// 40 km away is taken to be 40 km away in each direction, which keeps the
+// squares in 32 bits.
+static uint32_t distance_m(int32_t lat, int32_t lon, const coord_t *to) {
+    int32_t dlat = constrain(to->lat - lat, -40000L, 40000L);
+    int32_t dlon = constrain(to->lon - lon, -40000L, 40000L);
+    int32_t c = fix_cos(lat * FIX_DEG / 100000);
+
+    int32_t y = dlat * 11132 / 10000;
+    int32_t x = (dlon * 11132 / 10000) * c >> FIX_SHIFT;
+    return fix_isqrt32((uint32_t) (x * x) + (uint32_t) (y * y));
+}
+
+// How close following on a map comes to the limits, in 256ths: the larger
+// of the redraws a minute over AUTOZOOM_REDRAWS and the distance to the
+// turn over autozoom_turn_px.
+static uint32_t map_load(uint8_t map_num, uint16_t run_px, uint32_t turn_m) {
+    uint32_t mm_px = map_mm_per_px(map_num);
+    uint32_t redraw = speed_mm_s * 60 / run_px * 256 / mm_px
+        / AUTOZOOM_REDRAWS;
+    uint32_t turn = turn_m * 1000 / mm_px * 256 / autozoom_turn_px;
+    return max(redraw, turn);
+}
+
+uint8_t autozoom_level(uint8_t map_num, uint16_t run_px,
+    int32_t lat, int32_t lon, const coord_t *turn) {
+    if (!have_speed || run_px == 0) {
+        return map_num;
+    }
+
+    uint32_t turn_m = 0;
+    if (turn) {
+        turn_m = distance_m(lat, lon, turn);
+        if (turn_m > autozoom_turn_near_m &&
+            turn_m * 1000 / autozoom_turn_secs > speed_mm_s) {
+            turn_m = 0;
+        }
+    }
+
+    uint8_t level = map_num;
+    while (level > 0 && map_load(level, run_px, turn_m) > 256) {
+        level--;
+    }
+
+    uint32_t now = millis();
+    if (level == map_num && now - last_change >= AUTOZOOM_HOLD_MS) {
+        while (level < num_maps - 1 &&
+               map_load(level + 1, run_px, turn_m) <= autozoom_in_load) {
+            level++;
+        }
+    }
+
+    if (level != map_num) {
+        last_change = now;
+    }
+    return level;
+}
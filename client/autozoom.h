@@ -0,0 +1,58 @@
+/*
+ Speed-adaptive zoom for the GPS follow mode.
+
+ Following the dot redraws the map whenever the dot leaves the middle of
+ the screen, which at cycling speed on the detailed maps is every few
+ seconds.  Instead the map is chosen from the ground speed: the most
+ detailed map on which the dot crosses the screen slowly enough for at
+ most AUTOZOOM_REDRAWS redraws a minute, or a less detailed one if that
+ is needed to keep the next turn of the route on the screen.
+
+ Each map is twice as detailed as the one before, so each step in doubles
+ both the redraw rate and the distance to the turn on the screen.  The
+ zoom goes out as soon as either is over its limit, but only goes in when
+ the more detailed map would be well under both, and no sooner than
+ AUTOZOOM_HOLD_MS after the last change, so it does not flip between two
+ maps.
+ */
+
+#ifndef AUTOZOOM_H
+#define AUTOZOOM_H
+
+#include <stdint.h>
+#include "map.h"
+
+// Following the dot and turning a heading-up map share the follow mode's
+// FOLLOW_BUDGET redraws a minute.  The zoom aims for AUTOZOOM_TURNS fewer
+// moves of the window than that, so some of the budget is left for turns.
+#define AUTOZOOM_TURNS 2
+#define AUTOZOOM_REDRAWS (FOLLOW_BUDGET - AUTOZOOM_TURNS)
+
+// least time between zooming and zooming in again, in ms
+#define AUTOZOOM_HOLD_MS 10000
+
+/*
+    Feeds the ground speed from a GPS fix to the smoothed speed.
+
+  Arguments:
+  speed: Ground speed from TinyGPS, in 100ths of a knot, or
+    TinyGPS::GPS_INVALID_SPEED.
+*/
+void autozoom_speed(uint32_t speed);
+
+/*
+    Picks the map to follow the dot on.
+
+  Arguments:
+  map_num: The map shown now.
+  run_px: How far, in pixels, the dot travels between two moves of the
+    window, from follow_run().
+  lat, lon: The position of the dot, in 1e-5 degrees.
+  turn: The next turn of the route, or 0 if there is no route.
+
+  Returns: the map to show, map_num if it should stay.
+*/
+uint8_t autozoom_level(uint8_t map_num, uint16_t run_px,
+    int32_t lat, int32_t lon, const coord_t *turn);
+
+#endif
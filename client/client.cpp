@@ -9,16 +9,22 @@
 #include "TinyGPS.h"
 #include "GTPA010.h"
 #include "LSM303.h"
+#include "magcal.h"
+#include "predict.h"
+#include "autozoom.h"
 
 #include "joystick.h"
 #include "map.h"
 #include "path.h"
 #include "serial_handling.h"
 #include "ledon.h"
+#include "sched.h"
+#include "profile.h"
+#include "memwatch.h"
 
 // #define DEBUG_SCROLLING
 // #define DEBUG_PATH
-// #define DEBUG_MEMORY
+// #define DEBUG_SCHED
 
 TinyGPS gps;
 LSM303 compass;
@@ -33,9 +39,22 @@ const uint8_t tft_rst = 8;
 void initialize_sd_card();
 void initialize_screen();
 void initialize_joystick();
-uint8_t process_joystick(int16_t *dx, int16_t *dy);
+void initialize_zoom_buttons();
 void status_msg(char *msg);
+void redraw_overlays();
 void clear_status_msg();
+void compass_sample(const LSM303::sample *s);
+
+// Tasks run by the scheduler from loop()
+void joystick_task();
+void compass_task();
+void gps_task();
+void display_task();
+void path_task();
+void zoom_task();
+void report_task();
+void profile_task();
+void memory_task();
 
 // Interrupt routines for zooming in and out.
 void handle_zoom_in();
@@ -49,15 +68,38 @@ Adafruit_ST7735 tft = Adafruit_ST7735(tft_cs, tft_dc, tft_rst);
 // Map number (zoom level) currently selected.
 extern uint8_t current_map_num;
 
-// First time flag for loop, set to cause actions for the first time only
-uint8_t first_time;
+// Set when the map tile on screen has to be redrawn
+uint8_t update_display_window;
+
+// After a zoom, the map the screen still shows until the display task
+// puts up the preview, -1 if there is no zoom to show
+int8_t zoom_from_map = -1;
+
+// Set while the map after a zoom, or a heading-up map, is still coming in
+uint8_t map_refining = 0;
+
+// Set while the window follows the GPS dot.  A long press on the joystick
+// button turns it on, a second one turns the map heading up as well, and a
+// third turns both off.  Panning with the joystick turns both off.
+uint8_t following_gps = 0;
+
+// Set by a long press, so the release that ends it is not a select
+uint8_t long_press = 0;
+
+// Set while following the GPS dot picks the zoom from the speed.  Pushing
+// a zoom button takes the zoom back until following starts again.
+uint8_t auto_zoom = 0;
 
 void setup() {
     Sensors::Sensors();
-    Serial.begin(9600);
+    Serial.begin(SERIAL_BASE_BAUD);
     Serial.println("Starting...");
     Serial.flush();    // There can be nasty leftover bits.
 
+    // Ask the server for a faster link, stays at the base rate if the
+    // server is not there or does not support it.
+    serial_negotiate_baud();
+
     GTPA010::begin();
     Serial.println("GPS initialized!");
 
@@ -65,8 +107,17 @@ void setup() {
     compass.enableDefault();
     compass.setMagGain(LSM303::magGain_47);
     Serial.println("Compass initialized!");
+    if (!compass.calibrationLoaded()) {
+        Serial.println("No compass calibration in EEPROM, using defaults");
+    }
+
+    // Refine the hard iron offsets in the background from here on
+    lsm303_calibration cal;
+    compass.getCalibration(&cal);
+    magcal_begin(&cal);
+    compass.setSampleHook(compass_sample);
 
-    compass.read();
+    compass.update();
 #ifdef DEBUG
     if (!compass.timeoutOccurred()) {
         Serial.print("Compass heading: ");
@@ -78,7 +129,7 @@ void setup() {
 
 #ifdef GLASSES_DEBUG
     while (1) {
-        compass.reaqd();
+        compass.update();
         map_to_glasses(compass.heading());
     }
 #endif
@@ -89,6 +140,8 @@ void setup() {
 
     initialize_joystick();
 
+    initialize_zoom_buttons();
+
     initialize_map();
 
     // Want to start viewing window in the center of the map
@@ -100,7 +153,28 @@ void setup() {
                    screen_map_y + display_window_height / 2);
 
     // Draw the initial screen and cursor
-    first_time = 1;
+    update_display_window = 1;
+
+    // Joystick at 50 Hz, the compass every 15 ms as a sample takes it two
+    // passes (check data ready, then read) and the magnetometer makes 30
+    // a second, the GPS on every pass as it only does work when a sentence
+    // has come in, the screen at up to 20 frames a second, and the path
+    // and the auto zoom every second
+    sched_add("joystick", joystick_task, 20, 2000);
+    sched_add("compass", compass_task, 15, 3000);
+    sched_add("gps", gps_task, 0, 2000);
+    sched_add("display", display_task, 50, 20000);
+    sched_add("path", path_task, 1000, 5000);
+    sched_add("zoom", zoom_task, 1000, 2000);
+#ifdef DEBUG_SCHED
+    sched_add("report", report_task, 10000, 50000);
+#endif
+#ifdef PROFILE
+    sched_add("profile", profile_task, 100, 50000);
+#endif
+#ifdef DEBUG_MEMORY
+    sched_add("memory", memory_task, 1000, 10000);
+#endif
 
 #ifdef DEBUG_MEMORY
     Serial.print("Available mem:");
@@ -165,6 +239,13 @@ void refresh_display() {
 #endif
 
     draw_map_screen();
+    redraw_overlays();
+}
+
+/**
+ * Redraw everything that goes on top of the map
+ */
+void redraw_overlays() {
     draw_cursor();
 
     // Need to redraw any other things that are on the screen
@@ -180,6 +261,8 @@ void refresh_display() {
     char * pos_str = 0;
 #if FAKE_GPS_DATA
     pos_str = "USING FAKE DATA";
+#elif REPLAY_GPS_DATA
+    pos_str = "REPLAYING GPS LOG";
 #else
     if (GTPA010::gpsLock)
         pos_str = "USING GPS COORDS";
@@ -194,6 +277,11 @@ void refresh_display() {
  * Send a path request to the server and wait for a response
  */
 void query_path(int32_t s_lat, int32_t s_lon, int32_t e_lat, int32_t e_lon) {
+    PROFILE_BEGIN(QUERY_PATH);
+
+    // falls back or negotiates the rate if it has to, and clears out any
+    // late reply to an earlier request
+    serial_start_request();
 
     // send out the start and stop coordinates to the server
     Serial.print(s_lat);
@@ -213,6 +301,7 @@ void query_path(int32_t s_lat, int32_t s_lon, int32_t e_lat, int32_t e_lon) {
     // read the path from the serial port
     status_msg("WAITING");
     if ( read_path(&path_length, &path) ) {
+        serial_report_ok();
 #ifdef DEBUG_PATH
         uint8_t is_visible;
         for (uint16_t i=0; i < path_length; i++) {
@@ -227,42 +316,149 @@ void query_path(int32_t s_lat, int32_t s_lon, int32_t e_lat, int32_t e_lon) {
         }
 #endif
     } else {
+        // garbled or missing replies may mean the link rate is not working
+        if ( path_errno == 3 || path_errno == 4 ) {
+            serial_report_error();
+        }
+
         // should display this error on the screen
         pos_msg("Path error!");
     }
     refresh_display();
+
+    PROFILE_END(QUERY_PATH);
+}
+
+// Feeds every compass sample to the background calibration, and gives the
+// compass the new offsets when a fit is accepted.
+void compass_sample(const LSM303::sample *s) {
+    if (magcal_add(s->mx, s->my, s->mz)) {
+        lsm303_calibration cal;
+        compass.getCalibration(&cal);
+        magcal_offsets(cal.offset);
+        compass.setCalibration(&cal);
+    }
 }
 
-        int path_time = 0;
+int path_time = 0;
+
+// fixes already given to the predictor
+unsigned long int predicted_fixes = 0;
 
 void loop() {
+    sched_run();
+}
 
-    // Make sure we don't update the map tile on screen when we don't need to!
-    uint8_t update_display_window = 0;
+/**
+ * Compass: one sample per run, shared by the glasses and the compass
+ * widget
+ */
+void compass_task() {
+    PROFILE_BEGIN(COMPASS);
+    compass.update();
+    PROFILE_END(COMPASS);
 
-    if ( first_time ) {
-        first_time = 0;
-        update_display_window = 1;
+    // Update glasses heading
+    if (path_length > 0) {
+        int32_t est_lat, est_lon;
+        if (predict_position(millis(), &est_lat, &est_lon)) {
+            path_update_target(est_lat, est_lon);
+        }
+        map_to_glasses((int)(target_dir - compass.heading()) % 360);
+    }
+}
+
+/**
+ * GPS: give each new fix to the predictor, which carries the position on
+ * between fixes for the GPS dot and the glasses.
+ */
+void gps_task() {
+    PROFILE_BEGIN(GPS);
+    GTPA010::readData();
+    PROFILE_END(GPS);
+    if (GTPA010::fixCount() != predicted_fixes) {
+        predicted_fixes = GTPA010::fixCount();
+        gpsData *fix = GTPA010::getData();
+        predict_fix(fix->lat, fix->lon, millis(),
+                    gps.speed(), gps.course(), compass.heading());
+        autozoom_speed(gps.speed());
     }
+}
 
+/**
+ * Joystick: move the cursor, scrolling the map when it gets near the
+ * edge, and ask for a path when the button is pressed
+ */
+void joystick_task() {
     // Joystick displacement.
     int16_t dx = 0;
     int16_t dy = 0;
     uint8_t select_button_event = 0;
 
-    // Update glasses heading
-    if (path_length > 0) {
-        //Serial.print("Compass: ");
-        //Serial.println(compass.heading());
-        compass.read();
-        map_to_glasses((int)(target_dir - compass.heading()) % 360);
-    }
-
     // See if the joystick has moved, in which case we want to
     // also want to move the visible cursor on the screen.
 
-    // Process joystick input.
-    select_button_event = process_joystick(&dx, &dy);
+    // Take everything the joystick interrupt queued since the last run,
+    // adding up the moves.  A release is the select action.
+    PROFILE_BEGIN(JOYSTICK);
+    joy_event event;
+    while (joystick_event(&event)) {
+        if (event.type == JOY_MOVE) {
+            dx += event.dx;
+            dy += event.dy;
+            following_gps = 0;
+            if (map_heading_up) {
+                map_heading_up = 0;
+                map_rotation = 0;
+                update_display_window = 1;
+            }
+        } else if (event.type == JOY_LONG_PRESS) {
+            long_press = 1;
+            if (!following_gps) {
+                following_gps = 1;
+            } else if (!map_heading_up) {
+                map_heading_up = 1;
+                turn_map(compass.heading());
+            } else {
+                following_gps = 0;
+                map_heading_up = 0;
+                map_rotation = 0;
+            }
+            if (following_gps) {
+                start_follow_gps();
+            }
+            auto_zoom = following_gps;
+            update_display_window = 1;
+        } else if (event.type == JOY_RELEASE) {
+            if (long_press) {
+                long_press = 0;
+            } else {
+                select_button_event = 1;
+            }
+        } else if (event.type == JOY_ZOOM_IN) {
+            zoom_in();
+            auto_zoom = 0;
+        } else if (event.type == JOY_ZOOM_OUT) {
+            zoom_out();
+            auto_zoom = 0;
+        }
+    }
+    PROFILE_END(JOYSTICK);
+
+    // Apply the zoom here, once for all the presses taken above.  Only the
+    // cursor lat and lon survive it: centre the window on the cursor on the
+    // new map and leave the redraw, which brings the path, the GPS dot and
+    // the compass along, to the display task.
+    if (shared_new_map_num != current_map_num) {
+        if (zoom_from_map < 0) {
+            zoom_from_map = current_map_num;
+        }
+        set_zoom();
+        move_window_to(cursor_map_x - display_window_width / 2,
+                       cursor_map_y - display_window_height / 2);
+        dx = 0;
+        dy = 0;
+    }
 
     // the joystick routine filters out small changes, so anything non-0
     // is a real movement
@@ -314,9 +510,6 @@ void loop() {
 
     }
 
-    // at this point the screen is updated, with a new tile window and
-    // cursor position if necessary
-
     // will only be down once, then waits for a min time before allowing
     // pres again.
     if (select_button_event) {
@@ -351,13 +544,81 @@ void loop() {
         query_path(start_lat, start_lon, stop_lat, stop_lon);
         path_time = Sensors::getTime();
     } // end of select_button_event processing
+}
 
+/**
+ * Display: redraw the map tile if it moved, then the compass widget, the
+ * GPS dot and the status message
+ */
+void display_task() {
     // do we have to redraw the map tile?  
-    if (update_display_window) {
+    if (update_display_window && map_heading_up) {
+        // A turned map takes several times as long to read, so it comes in
+        // a band of rows per run, like after a zoom
+        update_display_window = 0;
+        zoom_from_map = -1;
+        draw_map_preview(current_map_num);
+        map_refining = 1;
+    } else if (update_display_window) {
+        update_display_window = 0;
+        zoom_from_map = -1;
+        map_refining = 0;
+        PROFILE_BEGIN(REFRESH);
         refresh_display();
+        PROFILE_END(REFRESH);
+    } else if (zoom_from_map >= 0) {
+        // A zoom: put up a quick stand-in straight away, the new map then
+        // comes in a band of rows per run
+        draw_map_preview(zoom_from_map);
+        draw_cursor();
+        zoom_from_map = -1;
+        map_refining = 1;
+        return;
     }
 
-    // Spam the server for a new path
+    if (map_refining) {
+        if (!draw_map_refine()) {
+            return;
+        }
+        map_refining = 0;
+        redraw_overlays();
+    }
+
+    // Refresh compass display
+    PROFILE_BEGIN(DRAW_COMPASS);
+    draw_compass();
+    PROFILE_END(DRAW_COMPASS);
+    // Refresh gps dot
+    PROFILE_BEGIN(DRAW_GPS_DOT);
+    draw_gps_dot();
+    PROFILE_END(DRAW_GPS_DOT);
+
+    // keep the dot on the screen and the map turned with the user, the
+    // redraw happens on the next run
+    if (following_gps && follow_gps()) {
+        update_display_window = 1;
+    }
+    if (map_heading_up && follow_turn(compass.heading())) {
+        update_display_window = 1;
+    }
+
+    // always update the status message area if message changes
+    // Indicate which point we are waiting for
+    if (map_heading_up && compass.timeoutOccurred()) {
+        status_msg("NO COMPASS");
+    } else if (map_heading_up) {
+        status_msg("HEADING UP");
+    } else if (following_gps) {
+        status_msg("FOLLOWING GPS");
+    } else if ( request_state == 0 ) {
+        status_msg("DESTINATION?");
+    }
+}
+
+/**
+ * Path: spam the server for a new path
+ */
+void path_task() {
     if (path_length > 0 && Sensors::getTime() - path_time >= 5) {
         gpsData * gData = GTPA010::getData();
         // If we've moved, request a new path
@@ -369,18 +630,69 @@ void loop() {
         }
         path_time = Sensors::getTime();
     }
+}
 
-    // Refresh compass display
-    draw_compass();
-    // Refresh gps dot
-    draw_gps_dot();
+/**
+ * Auto zoom: while following the GPS dot, pick the map from the speed and
+ * the next turn of the path, and zoom to it around the dot
+ */
+void zoom_task() {
+    if (!following_gps || !auto_zoom) {
+        return;
+    }
 
-    // always update the status message area if message changes
-    // Indicate which point we are waiting for
-    if ( request_state == 0 ) {
-        status_msg("DESTINATION?");
+    int32_t lat, lon;
+    if (!predict_position(millis(), &lat, &lon)) {
+        return;
+    }
+
+    coord_t turn;
+    uint8_t level = autozoom_level(current_map_num, follow_run(), lat, lon,
+                                   path_next_turn(&turn) ? &turn : 0);
+    if (level == current_map_num) {
+        return;
+    }
+
+    // the same zoom as from the buttons, just centred on the dot
+    if (zoom_from_map < 0) {
+        zoom_from_map = current_map_num;
+    }
+    shared_new_map_num = level;
+    set_zoom();
+    move_to_gps();
+}
+
+/**
+ * Report the scheduler counts on the serial port
+ */
+void report_task() {
+    sched_report();
+}
+
+#ifdef PROFILE
+/**
+ * Print the stage times when asked, or every so often
+ */
+void profile_task() {
+    profile_poll();
+}
+#endif
+
+#ifdef DEBUG_MEMORY
+uint32_t memory_report_time = 0;
+
+/**
+ * Track the stack and heap high water marks, and print them every so
+ * often
+ */
+void memory_task() {
+    memwatch_poll();
+    if (millis() - memory_report_time >= MEMWATCH_REPORT_MS) {
+        memory_report_time = millis();
+        memwatch_report();
     }
 }
+#endif
 
 char* prev_status_msg = 0;
 
@@ -418,6 +730,42 @@ void initialize_screen() {
     tft.fillScreen(BLUE);    
 }
 
+// zoom buttons, wired with the debounce circuit in circuit-wiring.txt
+const uint8_t zoom_in_pin = 3;
+const uint8_t zoom_out_pin = 2;
+const uint8_t zoom_in_interrupt = 1;    // pin 3
+const uint8_t zoom_out_interrupt = 0;   // pin 2
+
+// presses closer together than this are bounces, in ms
+const uint32_t zoom_debounce_ms = 150;
+volatile uint32_t zoom_press_time = 0;
+
+// Interrupt routines for zooming in and out, they only queue the request
+void handle_zoom_in() {
+    if (millis() - zoom_press_time >= zoom_debounce_ms) {
+        zoom_press_time = millis();
+        joystick_push_event(JOY_ZOOM_IN);
+    }
+}
+
+void handle_zoom_out() {
+    if (millis() - zoom_press_time >= zoom_debounce_ms) {
+        zoom_press_time = millis();
+        joystick_push_event(JOY_ZOOM_OUT);
+    }
+}
+
+void initialize_zoom_buttons() {
+    // turn on the pullups, a press pulls the pin low
+    pinMode(zoom_in_pin, INPUT);
+    digitalWrite(zoom_in_pin, HIGH);
+    pinMode(zoom_out_pin, INPUT);
+    digitalWrite(zoom_out_pin, HIGH);
+
+    attachInterrupt(zoom_in_interrupt, handle_zoom_in, FALLING);
+    attachInterrupt(zoom_out_interrupt, handle_zoom_out, FALLING);
+}
+
 void initialize_sd_card() {
     if (!SD.begin(sd_cs)) {
 #ifdef DEBUG_SERIAL
@@ -0,0 +1,109 @@
+#include "fixmath.h"
+
+#include <avr/pgmspace.h>
+
+// atan(i/16) for i = 0..16, in FIX_DEG units.
+static const int16_t atan_table[17] PROGMEM = {
+    0, 229, 456, 680, 898, 1111, 1316, 1512, 1700,
+    1879, 2048, 2209, 2360, 2502, 2636, 2762, 2880
+};
+
+// sin(i * 90/16 degrees) for i = 0..16, in Q14.
+static const int16_t sin_table[17] PROGMEM = {
+    0, 1606, 3196, 4756, 6270, 7723, 9102, 10394, 11585,
+    12665, 13623, 14449, 15137, 15679, 16069, 16305, 16384
+};
+
+uint16_t fix_isqrt32(uint32_t x) {
+    uint32_t root = 0;
+    uint32_t bit = (uint32_t) 1 << 30;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// atan(r) for 0 <= r <= 1, r in Q14.
+static int16_t atan_unit(uint16_t r) {
+    if (r >= FIX_ONE) {
+        return 45 * FIX_DEG;
+    }
+    uint8_t i = r >> (FIX_SHIFT - 4);
+    int16_t frac = r & ((1 << (FIX_SHIFT - 4)) - 1);
+    int16_t lo = pgm_read_word(&atan_table[i]);
+    int16_t hi = pgm_read_word(&atan_table[i + 1]);
+
+    return lo + (((int32_t) (hi - lo) * frac) >> (FIX_SHIFT - 4));
+}
+
+int16_t fix_atan2(int32_t y, int32_t x) {
+    uint32_t ax = x < 0 ? -(uint32_t) x : x;
+    uint32_t ay = y < 0 ? -(uint32_t) y : y;
+
+    if (ax == 0 && ay == 0) {
+        return 0;
+    }
+
+    // Keep the larger component below 2^17 so the Q14 ratio fits.
+    while ((ax | ay) >= ((uint32_t) 1 << 17)) {
+        ax >>= 1;
+        ay >>= 1;
+    }
+
+    int16_t angle;
+    if (ay <= ax) {
+        angle = atan_unit((ay << FIX_SHIFT) / ax);
+    } else {
+        angle = 90 * FIX_DEG - atan_unit((ax << FIX_SHIFT) / ay);
+    }
+
+    if (x < 0) {
+        angle = 180 * FIX_DEG - angle;
+    }
+    return y < 0 ? -angle : angle;
+}
+
+int16_t fix_sin(int32_t angle) {
+    const int32_t quarter = 90 * FIX_DEG;
+
+    angle %= 4 * quarter;
+    if (angle < 0) {
+        angle += 4 * quarter;
+    }
+
+    // fold into the first quarter wave
+    uint8_t negate = angle >= 2 * quarter;
+    if (negate) {
+        angle -= 2 * quarter;
+    }
+    if (angle > quarter) {
+        angle = 2 * quarter - angle;
+    }
+
+    // 16 table steps over the quarter
+    uint16_t pos = (uint32_t) angle * 16 * 256 / quarter;
+    uint8_t i = pos >> 8;
+    int16_t value;
+    if (i >= 16) {
+        value = FIX_ONE;
+    } else {
+        int16_t lo = pgm_read_word(&sin_table[i]);
+        int16_t hi = pgm_read_word(&sin_table[i + 1]);
+        value = lo + (((int32_t) (hi - lo) * (pos & 0xFF)) >> 8);
+    }
+    return negate ? -value : value;
+}
+
+int16_t fix_cos(int32_t angle) {
+    return fix_sin(angle + 90 * FIX_DEG);
+}
@@ -0,0 +1,51 @@
+/*
+ Integer replacements for the floating point math used on every loop.
+ The AVR has no FPU, so each float sin, cos or atan2 costs thousands of
+ cycles.  These are exact enough for the compass and the map.
+ */
+
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <stdint.h>
+
+// Angles are fixed point degrees, FIX_DEG units per degree.
+#define FIX_DEG 64
+
+// Unit vectors and sines are Q14: 1.0 is FIX_ONE.
+#define FIX_SHIFT 14
+#define FIX_ONE ((int32_t) 1 << FIX_SHIFT)
+
+/*
+    Integer square root.
+
+  Returns: floor(sqrt(x)).
+*/
+uint16_t fix_isqrt32(uint32_t x);
+
+/*
+    Integer four-quadrant arctangent of y/x, like atan2() from math.h.  The
+  octant is reduced to 0..45 degrees, where a small table is interpolated.
+  The error is below 0.05 degrees.
+
+  Arguments:
+  y, x: The components of the vector, any magnitude.
+
+  Returns: the angle of the vector in FIX_DEG units, from -180 to 180
+    degrees.  0 if both components are 0.
+*/
+int16_t fix_atan2(int32_t y, int32_t x);
+
+/*
+    Integer sine and cosine, by interpolating a quarter wave table.  The
+  error is below 0.002.
+
+  Arguments:
+  angle: In FIX_DEG units, any value.
+
+  Returns: the sine or cosine in Q14.
+*/
+int16_t fix_sin(int32_t angle);
+int16_t fix_cos(int32_t angle);
+
+#endif
@@ -1,201 +1,28 @@
-int32_t fd_lon [] = {
--11353058, 
--11353063, 
--11353063, 
--11353063, 
--11353063, 
--11353061, 
--11353061, 
--11353060, 
--11353059, 
--11353077, 
--11353116, 
--11353191, 
--11353286, 
--11353331, 
--11353380, 
--11353422, 
--11353427, 
--11353426, 
--11353422, 
--11353425, 
--11353426, 
--11353416, 
--11353415, 
--11353410, 
--11353404, 
--11353399, 
--11353396, 
--11353392, 
--11353388, 
--11353384, 
--11353382, 
--11353379, 
--11353374, 
--11353371, 
--11353367, 
--11353365, 
--11353362, 
--11353357, 
--11353354, 
--11353349, 
--11353346, 
--11353342, 
--11353339, 
--11353334, 
--11353333, 
--11353329, 
--11353325, 
--11353322, 
--11353319, 
--11353317, 
--11353316, 
--11353313, 
--11353311, 
--11353309, 
--11353306, 
--11353305, 
--11353301, 
--11353299, 
--11353297, 
--11353295, 
--11353293, 
--11353290, 
--11353287, 
--11353287, 
--11353285, 
--11353282, 
--11353280, 
--11353278, 
--11353274, 
--11353269, 
--11353264, 
--11353262, 
--11353258, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353246, 
--11353065, 
--11353060, 
--11353063, 
--11353062, 
--11353063, 
--11353063, 
--11352909, 
--11352743, 
--11352656, 
--11352603, 
--11352587, 
--11352570, 
--11352563}; 
+// Fake GPS trace generated by fakedata/fakedata.c from calvun path.kml,
+// do not edit.  98 points, deltas from the point before as
+// zigzag varints, latitude then longitude.
 
-int32_t fd_lat [] = {
-5352706,
-5352759,
-5352766,
-5352769,
-5352774,
-5352781,
-5352784,
-5352787,
-5352791,
-5352799,
-5352798,
-5352791,
-5352799,
-5352797,
-5352796,
-5352794,
-5352767,
-5352738,
-5352709,
-5352671,
-5352646,
-5352637,
-5352634,
-5352633,
-5352631,
-5352630,
-5352628,
-5352626,
-5352624,
-5352622,
-5352621,
-5352619,
-5352617,
-5352616,
-5352615,
-5352613,
-5352612,
-5352611,
-5352610,
-5352609,
-5352609,
-5352608,
-5352606,
-5352604,
-5352602,
-5352601,
-5352599,
-5352597,
-5352596,
-5352593,
-5352591,
-5352588,
-5352586,
-5352583,
-5352582,
-5352580,
-5352577,
-5352575,
-5352573,
-5352571,
-5352569,
-5352567,
-5352565,
-5352563,
-5352560,
-5352558,
-5352557,
-5352554,
-5352554,
-5352554,
-5352554,
-5352555,
-5352557,
-5352559,
-5352561,
-5352562,
-5352565,
-5352568,
-5352571,
-5352573,
-5352575,
-5352578,
-5352580,
-5352582,
-5352631,
-5352631,
-5352595,
-5352565,
-5352538,
-5352501,
-5352489,
-5352485,
-5352483,
-5352483,
-5352483,
-5352491,
-5352499,
-5352504};
+#include <avr/pgmspace.h>
 
-int fd_len = 98;
+const int fd_len = 98;
+
+const uint8_t fd_stream[] PROGMEM = {
+    0x84, 0xb4, 0x8d, 0x05, 0xc3, 0xef, 0xe9, 0x0a, 0x6a, 0x09, 0x0e, 0x00,
+    0x06, 0x00, 0x0a, 0x00, 0x0e, 0x04, 0x06, 0x00, 0x06, 0x02, 0x08, 0x02,
+    0x10, 0x23, 0x01, 0x4d, 0x0d, 0x95, 0x01, 0x10, 0xbd, 0x01, 0x03, 0x59,
+    0x01, 0x61, 0x03, 0x53, 0x35, 0x09, 0x39, 0x02, 0x39, 0x08, 0x4b, 0x05,
+    0x31, 0x01, 0x11, 0x14, 0x05, 0x02, 0x01, 0x0a, 0x03, 0x0c, 0x01, 0x0a,
+    0x03, 0x06, 0x03, 0x08, 0x03, 0x08, 0x03, 0x08, 0x01, 0x04, 0x03, 0x06,
+    0x03, 0x0a, 0x01, 0x06, 0x01, 0x08, 0x03, 0x04, 0x01, 0x06, 0x01, 0x0a,
+    0x01, 0x06, 0x01, 0x0a, 0x00, 0x06, 0x01, 0x08, 0x03, 0x06, 0x03, 0x0a,
+    0x03, 0x02, 0x01, 0x08, 0x03, 0x08, 0x03, 0x06, 0x01, 0x06, 0x05, 0x04,
+    0x03, 0x02, 0x05, 0x06, 0x03, 0x04, 0x05, 0x04, 0x01, 0x06, 0x03, 0x02,
+    0x05, 0x08, 0x03, 0x04, 0x03, 0x04, 0x03, 0x04, 0x03, 0x04, 0x03, 0x06,
+    0x03, 0x06, 0x03, 0x00, 0x05, 0x04, 0x03, 0x06, 0x01, 0x04, 0x05, 0x04,
+    0x00, 0x08, 0x00, 0x0a, 0x00, 0x0a, 0x02, 0x04, 0x04, 0x08, 0x04, 0x08,
+    0x04, 0x00, 0x02, 0x00, 0x06, 0x00, 0x06, 0x00, 0x06, 0x00, 0x04, 0x00,
+    0x04, 0x00, 0x06, 0x00, 0x04, 0x00, 0x04, 0x00, 0x62, 0x10, 0x00, 0xea,
+    0x02, 0x47, 0x0a, 0x3b, 0x05, 0x35, 0x02, 0x49, 0x01, 0x17, 0x00, 0x07,
+    0xb4, 0x02, 0x03, 0xcc, 0x02, 0x00, 0xae, 0x01, 0x00, 0x6a, 0x10, 0x20,
+    0x10, 0x22, 0x0a, 0x0e, 
+};
@@ -0,0 +1,12 @@
+#include "check.h"
+
+int check_failures = 0;
+
+int check_done(const char *test) {
+    if (check_failures) {
+        printf("%s: %d checks FAILED\n", test, check_failures);
+        return 1;
+    }
+    printf("%s: ok\n", test);
+    return 0;
+}
@@ -0,0 +1,24 @@
+/*
+ Checks for the host tests.  CHECK() prints the failed condition and
+ counts it, and check_done() gives main()'s exit status.
+ */
+
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+extern int check_failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while (0)
+
+// Prints the test's result and returns its exit status
+int check_done(const char *test);
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ The host side of the stubs in stub/.
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <avr/eeprom.h>
+#include <SD.h>
+#include <Adafruit_ST7735.h>
+
+HardwareSerial Serial;
+HardwareSerial Serial2;
+TwoWire Wire;
+
+uint64_t host_now_us = 0;
+uint32_t host_tick_us = 0;
+unsigned long host_serial_baud = 0;
+
+static const char *serial_data = 0;
+static size_t serial_length = 0;
+static size_t serial_pos = 0;
+
+unsigned long millis() {
+    host_now_us += host_tick_us;
+    return (unsigned long) (host_now_us / 1000);
+}
+
+unsigned long micros() {
+    host_now_us += host_tick_us;
+    return (unsigned long) host_now_us;
+}
+
+void delay(unsigned long ms) {
+    host_now_us += (uint64_t) ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+    host_now_us += us;
+}
+
+uint8_t OCR0A = 0;
+uint8_t TIMSK0 = 0;
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+int digitalRead(uint8_t pin) { return HIGH; }
+void noInterrupts() {}
+void interrupts() {}
+
+void host_serial_input(const char *data, size_t length) {
+    serial_data = data;
+    serial_length = length;
+    serial_pos = 0;
+}
+
+void HardwareSerial::begin(unsigned long baud) { host_serial_baud = baud; }
+void HardwareSerial::end() {}
+void HardwareSerial::flush() {}
+
+int HardwareSerial::available() {
+    return serial_length - serial_pos;
+}
+
+int HardwareSerial::peek() {
+    return serial_pos < serial_length ? (uint8_t) serial_data[serial_pos] : -1;
+}
+
+int HardwareSerial::read() {
+    return serial_pos < serial_length ? (uint8_t) serial_data[serial_pos++] : -1;
+}
+
+void (*host_serial_line)(const char *line) = 0;
+
+// the line being written, longer lines are cut short
+static char serial_line[128];
+static size_t serial_line_length = 0;
+
+size_t HardwareSerial::write(uint8_t c) {
+    if (c == '\n') {
+        serial_line[serial_line_length] = '\0';
+        serial_line_length = 0;
+        if (host_serial_line) {
+            host_serial_line(serial_line);
+        }
+    } else if (c != '\r' && serial_line_length < sizeof(serial_line) - 1) {
+        serial_line[serial_line_length++] = c;
+    }
+    return 1;
+}
+
+size_t HardwareSerial::print(const char *s) {
+    size_t n = 0;
+    while (s[n]) {
+        write(s[n++]);
+    }
+    return n;
+}
+
+size_t HardwareSerial::print(char c) { return write(c); }
+
+size_t HardwareSerial::print(long n, int base) {
+    char s[24];
+    snprintf(s, sizeof(s), base == 16 ? "%lX" : "%ld", n);
+    return print(s);
+}
+
+size_t HardwareSerial::print(unsigned long n, int base) {
+    char s[24];
+    snprintf(s, sizeof(s), base == 16 ? "%lX" : "%lu", n);
+    return print(s);
+}
+
+size_t HardwareSerial::print(double n, int digits) {
+    char s[48];
+    snprintf(s, sizeof(s), "%.*f", digits, n);
+    return print(s);
+}
+
+size_t HardwareSerial::println() { return print("\r\n"); }
+
+// the real one blinks the LED for ever
+void assert13(int invariant, int code) {
+    if (!invariant) {
+        printf("assert13 failed, code %d\n", code);
+        exit(2);
+    }
+}
+
+uint8_t host_eeprom[E2END + 1];
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+    memcpy(dst, host_eeprom + (size_t) src, n);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n) {
+    memcpy(host_eeprom + (size_t) dst, src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+    eeprom_write_block(src, dst, n);
+}
+
+SDClass SD;
+uint32_t host_sd_seeks = 0;
+uint32_t host_sd_bytes = 0;
+
+static const int sd_max_files = 8;
+static struct {
+    const char *name;
+    const uint8_t *data;
+    uint32_t size;
+} sd_files[sd_max_files];
+static int sd_file_count = 0;
+
+void host_sd_add(const char *name, const uint8_t *data, uint32_t size) {
+    for (int i = 0; i < sd_file_count; i++) {
+        if (strcmp(sd_files[i].name, name) == 0) {
+            sd_files[i].data = data;
+            sd_files[i].size = size;
+            return;
+        }
+    }
+    assert13(sd_file_count < sd_max_files, 1);
+    sd_files[sd_file_count].name = name;
+    sd_files[sd_file_count].data = data;
+    sd_files[sd_file_count].size = size;
+    sd_file_count++;
+}
+
+bool host_sd_load(const char *name, const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // kept until the test exits, like the card
+    uint8_t *data = (uint8_t *) malloc(size > 0 ? size : 1);
+    bool ok = size >= 0 && fread(data, 1, size, f) == (size_t) size;
+    fclose(f);
+    if (!ok) {
+        free(data);
+        return false;
+    }
+    host_sd_add(name, data, size);
+    return true;
+}
+
+File SDClass::open(const char *name, uint8_t mode) {
+    File f;
+    for (int i = 0; i < sd_file_count; i++) {
+        if (strcmp(sd_files[i].name, name) == 0) {
+            f.data = sd_files[i].data;
+            f.size_ = sd_files[i].size;
+        }
+    }
+    return f;
+}
+
+bool File::seek(uint32_t p) {
+    host_sd_seeks++;
+    if (p > size_) {
+        return false;
+    }
+    pos = p;
+    return true;
+}
+
+int File::peek() {
+    return pos < size_ ? data[pos] : -1;
+}
+
+int File::read() {
+    if (pos >= size_) {
+        return -1;
+    }
+    host_sd_bytes++;
+    return data[pos++];
+}
+
+int File::read(void *buf, uint16_t n) {
+    if (n > size_ - pos) {
+        n = size_ - pos;
+    }
+    memcpy(buf, data + pos, n);
+    pos += n;
+    host_sd_bytes += n;
+    return n;
+}
+
+uint16_t host_screen[ST7735_TFTHEIGHT][ST7735_TFTWIDTH];
+uint32_t host_screen_pushes = 0;
+
+// the address window and the next pixel in it
+static uint8_t win_x0, win_y0, win_x1, win_y1, win_x, win_y;
+
+Adafruit_ST7735::Adafruit_ST7735(uint8_t cs, uint8_t rs, uint8_t rst) {}
+
+void Adafruit_ST7735::setAddrWindow(uint8_t x0, uint8_t y0,
+        uint8_t x1, uint8_t y1) {
+    assert13(x0 <= x1 && x1 < ST7735_TFTWIDTH, 2);
+    assert13(y0 <= y1 && y1 < ST7735_TFTHEIGHT, 3);
+    win_x0 = win_x = x0;
+    win_y0 = win_y = y0;
+    win_x1 = x1;
+    win_y1 = y1;
+}
+
+// Like the screen, wraps to the top of the window after its last pixel
+void Adafruit_ST7735::pushColor(uint16_t color) {
+    host_screen[win_y][win_x] = color;
+    host_screen_pushes++;
+    if (win_x++ == win_x1) {
+        win_x = win_x0;
+        if (win_y++ == win_y1) {
+            win_y = win_y0;
+        }
+    }
+}
+
+void Adafruit_ST7735::drawPixel(int16_t x, int16_t y, uint16_t color) {
+    if (x >= 0 && x < ST7735_TFTWIDTH && y >= 0 && y < ST7735_TFTHEIGHT) {
+        host_screen[y][x] = color;
+    }
+}
+
+void Adafruit_ST7735::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+        uint16_t color) {
+    for (int16_t j = y; j < y + h; j++) {
+        for (int16_t i = x; i < x + w; i++) {
+            drawPixel(i, j, color);
+        }
+    }
+}
+
+void Adafruit_ST7735::fillScreen(uint16_t color) {
+    fillRect(0, 0, ST7735_TFTWIDTH, ST7735_TFTHEIGHT, color);
+}
+
+void Adafruit_ST7735::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+        uint16_t color) {
+    int16_t dx = abs(x1 - x0), dy = -abs(y1 - y0);
+    int16_t sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+    while (true) {
+        drawPixel(x0, y0, color);
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+        int16_t e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+void Adafruit_ST7735::fillCircle(int16_t x0, int16_t y0, int16_t r,
+        uint16_t color) {
+    for (int16_t y = -r; y <= r; y++) {
+        for (int16_t x = -r; x <= r; x++) {
+            if (x * x + y * y <= r * r) {
+                drawPixel(x0 + x, y0 + y, color);
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ The ST7735 screen, drawn into host_screen.
+ */
+
+#ifndef HOST_ADAFRUIT_ST7735_H
+#define HOST_ADAFRUIT_ST7735_H
+
+#include <Arduino.h>
+
+#define ST7735_TFTWIDTH 128
+#define ST7735_TFTHEIGHT 160
+
+class Adafruit_ST7735 {
+public:
+    Adafruit_ST7735(uint8_t cs, uint8_t rs, uint8_t rst);
+    void setAddrWindow(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+    void pushColor(uint16_t color);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+    void fillScreen(uint16_t color);
+    void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                  uint16_t color);
+    void fillCircle(int16_t x0, int16_t y0, int16_t r, uint16_t color);
+
+    // text is not drawn
+    void setCursor(int16_t x, int16_t y) {}
+    void setTextColor(uint16_t c) {}
+    void setTextColor(uint16_t c, uint16_t bg) {}
+    void setTextSize(uint8_t s) {}
+    void print(const char *s) {}
+    void println(const char *s) {}
+};
+
+extern uint16_t host_screen[ST7735_TFTHEIGHT][ST7735_TFTWIDTH];
+
+// pixels pushed since the start
+extern uint32_t host_screen_pushes;
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ Just enough of the Arduino core to build the client's portable modules
+ on a PC.  See ../readme.txt.
+
+ The clock is simulated: it only moves when a test moves it, or by
+ host_tick_us on every millis() or micros() call, so that loops waiting
+ on the clock end.  Serial reads from a buffer given by the test, and
+ hands what is written to it to the test a line at a time.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define radians(deg) ((deg)*DEG_TO_RAD)
+#define degrees(rad) ((rad)*RAD_TO_DEG)
+#define sq(x) ((x)*(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+inline long map(long x, long in_min, long in_max, long out_min, long out_max) {
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+// functions rather than the core's macros, so the C++ library still builds
+template<class A, class B>
+inline auto min(A a, B b) -> decltype(a + b) { return a < b ? a : b; }
+template<class A, class B>
+inline auto max(A a, B b) -> decltype(a + b) { return a > b ? a : b; }
+
+#define _BV(bit) (1 << (bit))
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *) (p))
+#define pgm_read_word(p) (*(const uint16_t *) (p))
+#define pgm_read_dword(p) (*(const uint32_t *) (p))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void noInterrupts();
+void interrupts();
+
+// Timer0's compare A, which GTPA010 borrows.  An ISR is a plain function
+// that nothing calls unless the test does.
+extern uint8_t OCR0A;
+extern uint8_t TIMSK0;
+#define OCIE0A 1
+#define ISR(vector) void vector()
+
+class HardwareSerial {
+public:
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int peek();
+    int read();
+    void flush();
+    size_t write(uint8_t c);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(long n, int base = 10);
+    size_t print(unsigned long n, int base = 10);
+    size_t print(int n, int base = 10) { return print((long) n, base); }
+    size_t print(unsigned int n, int base = 10) { return print((unsigned long) n, base); }
+    size_t print(double n, int digits = 2);
+    size_t println();
+    size_t println(const char *s) { return print(s) + println(); }
+    size_t println(char c) { return print(c) + println(); }
+    size_t println(long n, int base = 10) { return print(n, base) + println(); }
+    size_t println(unsigned long n, int base = 10) { return print(n, base) + println(); }
+    size_t println(int n, int base = 10) { return print(n, base) + println(); }
+    size_t println(unsigned int n, int base = 10) { return print(n, base) + println(); }
+    size_t println(double n, int digits = 2) { return print(n, digits) + println(); }
+};
+
+extern HardwareSerial Serial;
+
+// the GPS port, which shares Serial's buffers
+extern HardwareSerial Serial2;
+
+// Simulated clock, in microseconds since the start
+extern uint64_t host_now_us;
+
+// added to the clock on every millis() or micros() call
+extern uint32_t host_tick_us;
+
+// Makes the next Serial reads return the given bytes, which are not copied
+void host_serial_input(const char *data, size_t length);
+
+// the rate passed to the last Serial.begin()
+extern unsigned long host_serial_baud;
+
+// Called, when set, with each line written to Serial, without its CRLF
+extern void (*host_serial_line)(const char *line);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ The SD card, holding the files the test gives to host_sd_add() or loads
+ from the PC with host_sd_load().
+ */
+
+#ifndef HOST_SD_H
+#define HOST_SD_H
+
+#include <Arduino.h>
+
+#define FILE_READ 0
+
+class File {
+public:
+    File() : data(0), size_(0), pos(0) {}
+    operator bool() { return data != 0; }
+    bool seek(uint32_t p);
+    uint32_t position() { return pos; }
+    uint32_t size() { return size_; }
+    int available() { return size_ - pos; }
+    int peek();
+    int read();
+    int read(void *buf, uint16_t n);
+    void close() { data = 0; }
+
+    const uint8_t *data;
+    uint32_t size_;
+    uint32_t pos;
+};
+
+class SDClass {
+public:
+    bool begin(uint8_t cs) { return true; }
+    File open(const char *name, uint8_t mode = FILE_READ);
+};
+
+extern SDClass SD;
+
+// Makes data, which is not copied, readable as the file name
+void host_sd_add(const char *name, const uint8_t *data, uint32_t size);
+
+// Reads the PC's file at path and serves it as the file name, false if
+// it could not be read
+bool host_sd_load(const char *name, const char *path);
+
+// seeks made and bytes read since the start
+extern uint32_t host_sd_seeks;
+extern uint32_t host_sd_bytes;
+
+#endif
@@ -0,0 +1,3 @@
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+#endif
@@ -0,0 +1,24 @@
+/*
+ The I2C bus, with nothing on it.  Tests of code that reads a device
+ through the queued reads in twi.h supply twi_submitRead() themselves.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+    void begin() {}
+    void beginTransmission(uint8_t address) {}
+    uint8_t endTransmission() { return 2; }
+    size_t write(uint8_t data) { return 1; }
+    uint8_t requestFrom(uint8_t address, uint8_t length) { return 0; }
+    int available() { return 0; }
+    int read() { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ The EEPROM, held in host_eeprom, all zero at the start.
+ */
+
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END 0xFFF
+
+extern uint8_t host_eeprom[E2END + 1];
+
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,4 @@
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+#include <Arduino.h>
+#endif
@@ -0,0 +1,9 @@
+/*
+ map.h includes this library header, but nothing the host tests use
+ comes from it.
+ */
+
+#ifndef HOST_IMAGE_HANDLING_H
+#define HOST_IMAGE_HANDLING_H
+#include <Arduino.h>
+#endif
@@ -0,0 +1,97 @@
+/*
+ The auto zoom, fed a fix a second as zoom_task() is: which map it picks
+ at steady speeds north up and heading up, that a speed swinging across
+ the boundary between two maps does not flip between them, and that a
+ turn ahead zooms out to keep it on the screen.
+ */
+
+#include <Arduino.h>
+#include "autozoom.h"
+#include "TinyGPS.h"
+#include "check.h"
+
+// The maps' sizes and bounds, as in map.cpp
+const uint8_t num_maps = 6;
+uint16_t map_y_limit[6] = { 511, 1023, 2047, 4095, 8191, 16383};
+map_box_t map_box[] = {
+    { 5364463, -11373047, 5343572, -11337891 },
+    { 5364464, -11373047, 5343572, -11337891 },
+    { 5361858, -11368652, 5340953, -11333496 },
+    { 5360554, -11368652, 5339643, -11333496 },
+    { 5360554, -11367554, 5339643, -11332397 },
+    { 5360228, -11367554, 5339316, -11332397 },
+};
+
+// follow_run() north up and heading up, from follow_margin_x/y and
+// follow_radius in map.cpp
+static const uint16_t run_north_up = 64;
+static const uint16_t run_heading_up = 24;
+
+static const int32_t lat = 5352000, lon = -11350000;
+
+static uint8_t map_num = 5;
+static int changes = 0;
+
+// One second of following at kmh, with the turn given or none
+static void second(double kmh, uint16_t run_px, const coord_t *turn) {
+    delay(1000);
+    autozoom_speed(lround(kmh / 1.852 * 100));
+    uint8_t level = autozoom_level(map_num, run_px, lat, lon, turn);
+    if (level != map_num) {
+        changes++;
+        map_num = level;
+    }
+}
+
+// The map picked after two minutes at a steady speed
+static uint8_t steady(double kmh, uint16_t run_px) {
+    for (int i = 0; i < 120; i++) {
+        second(kmh, run_px, 0);
+    }
+    return map_num;
+}
+
+int main() {
+    // the table, going up in speed and then back down
+    printf("km/h:       ");
+    for (int kmh = 2; kmh <= 44; kmh += 2) {
+        printf("%3d", kmh);
+    }
+    printf("\nnorth up:   ");
+    for (int kmh = 2; kmh <= 44; kmh += 2) {
+        uint8_t m = steady(kmh, run_north_up);
+        printf("%3u", m);
+        CHECK(kmh <= 20 ? m == 5 : kmh <= 40 ? m == 4 : m <= 4);
+    }
+    printf("\nheading up: ");
+    for (int kmh = 2; kmh <= 44; kmh += 2) {
+        uint8_t m = steady(kmh, run_heading_up);
+        printf("%3u", m);
+        CHECK(kmh < 18 || kmh > 32 || m == 3);
+    }
+    printf("\n");
+    CHECK(steady(30, run_north_up) == 4);
+    CHECK(steady(14, run_north_up) == 5);
+    CHECK(steady(2, run_north_up) == 5);
+
+    // ten minutes swinging between 17 and 25 km/h every minute
+    steady(21, run_north_up);
+    changes = 0;
+    for (int i = 0; i < 600; i++) {
+        second(21 + 4 * sin(i * 2 * M_PI / 60), run_north_up, 0);
+    }
+    printf("17-25 km/h for 10 minutes: map changed %d times\n", changes);
+    CHECK(changes <= 1);
+
+    // walking with a turn 180 m ahead, then past it
+    steady(5, run_north_up);
+    coord_t turn = { lat + 162, lon };
+    for (int i = 0; i < 5; i++) {
+        second(5, run_north_up, &turn);
+    }
+    printf("5 km/h, turn 180 m ahead: map %u\n", map_num);
+    CHECK(map_num <= 3);
+    CHECK(steady(5, run_north_up) == 5);
+
+    return check_done("test_autozoom");
+}
@@ -0,0 +1,215 @@
+/*
+ The serial rate handshake, against a stand-in for the server's
+ baud.Negotiator: negotiating at the start, falling back after an error
+ and waiting out the server's link timeout, moving on from a rate whose
+ sync fails, dropping a rate after SERIAL_MAX_ERRORS fallbacks, and a
+ server that does not know the handshake.  serial_start_request() must
+ never hold up the rest of the client for more than a reply timeout.
+ */
+
+#include <Arduino.h>
+#include "serial_handling.h"
+#include "check.h"
+
+// The stand-in server, as server/baud.py
+static const uint32_t base_rate = SERIAL_BASE_BAUD;
+static const uint32_t link_timeout = SERIAL_LINK_TIMEOUT;
+static const uint32_t sync_timeout = 1000;
+
+static uint32_t server_rate = base_rate;
+static uint32_t server_last_ok = 0;
+static uint8_t server_syncing = 0;
+static uint32_t server_sync_deadline = 0;
+
+static uint8_t server_knows_handshake = 1;
+static uint32_t server_broken_rate = 0;    // the line garbles this rate
+static uint8_t server_drop_request = 0;    // the next request is lost
+static uint32_t server_lossy_rate = 0;     // requests at this rate are lost
+
+static uint8_t server_heard_request = 0;
+static int proposals = 0;                  // "B" lines heard
+static int early_proposals = 0;            // sent while the rates differed
+
+// what the server has sent that the client has not read yet
+static char input[256];
+static size_t input_length = 0;
+
+static uint32_t server_now() {
+    return (uint32_t) (host_now_us / 1000);
+}
+
+// The client only gets a line sent at its own rate
+static void server_send(const char *line) {
+    size_t unread = Serial.available();
+    memmove(input, input + input_length - unread, unread);
+    input_length = unread;
+    if (server_rate != host_serial_baud || server_rate == server_broken_rate) {
+        line = "\xe3\x8f";
+    }
+    input_length += snprintf(input + input_length,
+                             sizeof(input) - input_length, "%s\r\n", line);
+    host_serial_input(input, input_length);
+}
+
+static void server_line(const char *line) {
+    uint32_t now = server_now();
+    uint8_t heard = host_serial_baud == server_rate &&
+                    server_rate != server_broken_rate;
+
+    if (server_rate != base_rate && now - server_last_ok >= link_timeout) {
+        server_rate = base_rate;
+        server_syncing = 0;
+        return;
+    }
+
+    if (server_syncing) {
+        server_syncing = 0;
+        if (now - server_sync_deadline < 0x80000000UL) {
+            server_rate = base_rate;
+        } else if (heard && strcmp(line, "S") == 0) {
+            server_send("S");
+            server_last_ok = now;
+            return;
+        } else {
+            server_rate = base_rate;
+            return;
+        }
+    }
+
+    if (!heard) {
+        return;
+    }
+
+    uint32_t rate;
+    if (sscanf(line, "B %lu", (unsigned long *) &rate) == 1) {
+        proposals++;
+        if (!server_knows_handshake) {
+            return;
+        }
+        if (rate != 57600 && rate != 115200 && rate != 250000) {
+            server_send("N");
+            return;
+        }
+        char reply[16];
+        snprintf(reply, sizeof(reply), "A %lu", (unsigned long) rate);
+        server_send(reply);
+        server_rate = rate;
+        server_last_ok = now;
+        server_syncing = 1;
+        server_sync_deadline = now + sync_timeout;
+        return;
+    }
+
+    if (server_drop_request || server_rate == server_lossy_rate) {
+        server_drop_request = 0;
+        return;
+    }
+    server_heard_request = 1;
+    server_last_ok = now;
+}
+
+// Every line the client sends goes to the server, and proposals made
+// while the server is at another rate are counted
+static void client_line(const char *line) {
+    if (line[0] == 'B' && host_serial_baud != server_rate) {
+        early_proposals++;
+    }
+    server_line(line);
+}
+
+static uint32_t longest_start_ms = 0;
+
+// One path request as client.cpp sends it, then wait_ms until the next
+static void request(uint32_t wait_ms) {
+    uint64_t start = host_now_us;
+    serial_start_request();
+    longest_start_ms = max(longest_start_ms,
+                           (uint32_t) ((host_now_us - start) / 1000));
+
+    server_heard_request = 0;
+    Serial.println("5352706 -11353058 5352491 -11352563");
+    if (server_heard_request) {
+        serial_report_ok();
+    } else {
+        serial_report_error();
+    }
+    delay(wait_ms);
+}
+
+// Requests every 5 s, as path_task() makes them, for secs.  Returns the
+// time until the client was at rate, in ms, or -1 if it never was
+static int32_t requests_until(uint32_t rate, uint32_t secs) {
+    uint32_t start = server_now();
+    for (uint32_t t = 0; t < secs; t += 5) {
+        if (host_serial_baud == rate && server_rate == rate) {
+            return server_now() - start;
+        }
+        request(5000);
+    }
+    return host_serial_baud == rate && server_rate == rate ?
+        (int32_t) (server_now() - start) : -1;
+}
+
+int main() {
+    host_tick_us = 100;
+    host_serial_line = client_line;
+    Serial.begin(SERIAL_BASE_BAUD);
+
+    // at the start the fastest rate is taken
+    CHECK(serial_negotiate_baud() == 250000);
+    CHECK(server_rate == 250000);
+
+    // a request every 5 s keeps it up
+    CHECK(requests_until(0, 60) < 0);
+    CHECK(host_serial_baud == 250000 && server_rate == 250000);
+
+    // a lost request drops the client to the base rate, and it stays
+    // there until the server is sure to have followed
+    server_drop_request = 1;
+    request(5000);
+    CHECK(host_serial_baud == base_rate);
+    int32_t back = requests_until(250000, 60);
+    printf("back at 250000 %ld ms after the fallback\n", (long) back);
+    CHECK(back >= SERIAL_LINK_TIMEOUT - 5000 && back <= 20000);
+
+    // the sync fails at 250000: a request half a second later makes no
+    // proposal, and the next rate is taken on a later request
+    server_broken_rate = 250000;
+    request(5000);
+    int before = proposals;
+    for (int i = 0; i < 100 && proposals == before; i++) {
+        request(500);
+    }
+    CHECK(host_serial_baud == base_rate);
+    request(4500);
+    CHECK(proposals - before == 1);
+    request(5000);
+    CHECK(proposals - before == 2);
+    CHECK(host_serial_baud == 115200 && server_rate == 115200);
+    server_broken_rate = 0;
+
+    // a rate that syncs but loses the requests is given up after
+    // SERIAL_MAX_ERRORS fallbacks in a row
+    server_lossy_rate = 115200;
+    CHECK(requests_until(57600, 120) >= 0);
+    CHECK(proposals - before == 2 + SERIAL_MAX_ERRORS);
+    server_lossy_rate = 0;
+
+    // a server that ignores the handshake costs one reply timeout, then
+    // nothing more is proposed
+    server_knows_handshake = 0;
+    server_drop_request = 1;
+    request(5000);
+    before = proposals;
+    CHECK(requests_until(57600, 120) < 0);
+    CHECK(proposals - before == 1);
+    CHECK(host_serial_baud == base_rate);
+
+    printf("longest serial_start_request() %lu ms, %d proposals while "
+           "the server was at another rate\n",
+           (unsigned long) longest_start_ms, early_proposals);
+    CHECK(early_proposals == 0);
+    CHECK(longest_start_ms < 1100);
+
+    return check_done("test_baud");
+}
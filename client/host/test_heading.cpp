@@ -0,0 +1,168 @@
+/*
+ The fixed point compass: fix_isqrt32(), fix_atan2() and fix_sin() against
+ the C library, and the tilt-compensated heading from LSM303::update()
+ against the float calculation it replaced, with the device tilted up to
+ 85 degrees.  The samples go through the queued reads of a simulated
+ LSM303DLHC.
+ */
+
+#include <Arduino.h>
+#include <LSM303.h>
+#include "fixmath.h"
+#include "check.h"
+
+// The simulated device's readings: accelerometer in 1/1000 g, as left
+// after decodeAcc() drops the low 4 bits, and magnetometer in counts
+static int16_t acc[3], mag[3];
+
+static void put16(byte *p, int16_t v, bool big_endian) {
+    p[big_endian ? 0 : 1] = (uint16_t) v >> 8;
+    p[big_endian ? 1 : 0] = v & 0xFF;
+}
+
+// Every queued read completes at once
+extern "C" uint8_t twi_submitRead(twi_request *req) {
+    uint8_t reg = req->reg & 0x7F;
+    if (reg == LSM303_SR_REG_M) {
+        req->data[0] = LSM303_DRDY_M;
+    } else if (reg == LSM303_STATUS_REG_A) {
+        req->data[0] = LSM303_ZYXDA_A;
+        for (int i = 0; i < 3; i++) {
+            put16(req->data + 1 + 2 * i, acc[i] * 16, false);
+        }
+    } else if (reg == LSM303_OUT_X_H_M) {
+        // the DLHC sends X, Z, Y
+        put16(req->data, mag[0], true);
+        put16(req->data + 2, mag[2], true);
+        put16(req->data + 4, mag[1], true);
+    }
+    req->status = TWI_REQ_DONE;
+    return 0;
+}
+
+extern "C" void twi_cancelRead(twi_request *req) {
+    req->status = TWI_REQ_ERROR;
+}
+
+static int samples = 0;
+
+static void count_sample(const LSM303::sample *s) {
+    samples++;
+}
+
+// The float heading the fixed point code replaced
+static double float_heading(double ax, double ay, double az,
+    double mx, double my, double mz) {
+    double n = sqrt(ax * ax + ay * ay + az * az);
+    double pitch = asin(-ax / n);
+    double roll = asin(ay / n / cos(pitch));
+    double xh = mx * cos(pitch) + mz * sin(pitch);
+    double yh = mx * sin(roll) * sin(pitch) + my * cos(roll)
+        - mz * sin(roll) * cos(pitch);
+    return atan2(yh, xh) * 180 / M_PI;
+}
+
+static double angle_diff(double a, double b) {
+    double d = fmod(a - b, 360);
+    if (d > 180) {
+        d -= 360;
+    }
+    if (d < -180) {
+        d += 360;
+    }
+    return fabs(d);
+}
+
+// a repeatable uniform random number in [-1, 1)
+static double uniform() {
+    static uint32_t x = 12345;
+    x = x * 1103515245 + 12345;
+    return (double) (x >> 8) / (1 << 23) - 1;
+}
+
+int main() {
+    for (uint32_t x = 0; x < 20000000; x += 13) {
+        uint32_t s = fix_isqrt32(x);
+        CHECK((uint64_t) s * s <= x && (uint64_t) (s + 1) * (s + 1) > x);
+    }
+    CHECK(fix_isqrt32(0xFFFFFFFFUL) == 65535);
+
+    double atan2_err = 0;
+    for (int i = 0; i < 2000000; i++) {
+        int32_t y = uniform() * (1L << (i % 31));
+        int32_t x = uniform() * (1L << (i * 7 % 31));
+        if (x == 0 && y == 0) {
+            continue;
+        }
+        double d = angle_diff(fix_atan2(y, x) / (double) FIX_DEG,
+                              atan2(y, x) * 180 / M_PI);
+        atan2_err = max(atan2_err, d);
+    }
+    CHECK(atan2_err < 0.05);
+
+    double sin_err = 0;
+    for (int32_t a = -720 * FIX_DEG; a <= 720 * FIX_DEG; a++) {
+        double r = a * M_PI / 180 / FIX_DEG;
+        sin_err = max(sin_err, fabs(fix_sin(a) / (double) FIX_ONE - sin(r)));
+        sin_err = max(sin_err, fabs(fix_cos(a) / (double) FIX_ONE - cos(r)));
+    }
+    CHECK(sin_err < 0.002);
+
+    // No filtering and no calibration, so each heading is from one sample
+    LSM303 compass;
+    compass.init(LSM303DLHC_DEVICE);
+    lsm303_calibration cal;
+    compass.getCalibration(&cal);
+    for (int i = 0; i < 3; i++) {
+        cal.offset[i] = 0;
+        cal.scale[i] = LSM303_CAL_ONE;
+    }
+    compass.setCalibration(&cal);
+    compass.setHeadingFilter(0, 180, 0);
+    compass.setSampleHook(count_sample);
+
+    const int vectors = 200000;
+    const double inclination = 76 * M_PI / 180, field = 220;
+    double heading_err = 0;
+    for (int i = 0; i < vectors; i++) {
+        double pitch = uniform() * 85 * M_PI / 180;
+        double roll = uniform() * 85 * M_PI / 180;
+        double yaw = uniform() * M_PI;
+
+        // gravity and the earth's field in the device's axes
+        double sp = sin(pitch), cp = cos(pitch);
+        double sr = sin(roll), cr = cos(roll);
+        double hx = field * cos(inclination) * cos(yaw);
+        double hy = field * cos(inclination) * sin(yaw);
+        double hz = field * sin(inclination);
+        acc[0] = lround(-1000 * sp);
+        acc[1] = lround(1000 * cp * sr);
+        acc[2] = lround(1000 * cp * cr);
+        mag[0] = lround(cp * hx + sr * sp * hy - cr * sp * hz);
+        mag[1] = lround(cr * hy + sr * hz);
+        mag[2] = lround(sp * hx - sr * cp * hy + cr * cp * hz);
+
+        // one sample takes a few polls
+        int before = samples;
+        for (int j = 0; j < 4 && samples == before; j++) {
+            delay(LSM303_POLL_MS);
+            compass.update();
+        }
+        CHECK(samples == before + 1);
+
+        // the heading before update() cuts it to whole degrees
+        double ref = float_heading(acc[0], acc[1], acc[2],
+                                   mag[0], mag[1], mag[2]);
+        double d = angle_diff(compass.headingFine() / (double) FIX_DEG, ref);
+        heading_err = max(heading_err, d);
+        CHECK(compass.heading() == compass.headingFine() / FIX_DEG);
+    }
+    CHECK(heading_err < 1.0);
+    CHECK(!compass.timeoutOccurred());
+
+    printf("fix_atan2 max error %.3f deg, fix_sin/cos max error %.5f, "
+           "heading max difference %.2f deg over %d samples\n",
+           atan2_err, sin_err, heading_err, vectors);
+
+    return check_done("test_heading");
+}
@@ -0,0 +1,166 @@
+/*
+ The background hard iron calibration, fed 30 Hz samples of a device
+ with a known offset.  Turning round on level ground must bring the two
+ horizontal offsets to the true ones and leave the vertical one where it
+ started, as the pull towards the start is meant to.  Walking straight
+ on, or samples along one axis or at a single point, must not move the
+ offsets, and after the offset changes the fit must follow it as fast as
+ its forgetting allows.
+ */
+
+#include <Arduino.h>
+#include "magcal.h"
+#include "check.h"
+
+// The field near Edmonton, in calibrated units: 500 in all, dipping 77
+// degrees, so a quarter of it is horizontal
+static const double field = 500;
+static const double dip = 77 * DEG_TO_RAD;
+
+// soft iron scales, as the calibrate sketch might leave them
+static const int16_t scale[3] = { 282, 230, 256 };
+
+static const double sample_hz = 30;
+
+static uint32_t noise_state = 1;
+
+// uniform noise of +-n raw counts
+static int16_t noise(int16_t n) {
+    noise_state = noise_state * 1103515245 + 12345;
+    return (int16_t) ((noise_state >> 16) % (2 * n + 1)) - n;
+}
+
+// a calibration with the given offsets and scale[]
+static lsm303_calibration calibration(int16_t x, int16_t y, int16_t z) {
+    lsm303_calibration cal;
+    memset(&cal, 0, sizeof(cal));
+    cal.offset[0] = x;
+    cal.offset[1] = y;
+    cal.offset[2] = z;
+    for (int i = 0; i < 3; i++) {
+        cal.scale[i] = scale[i];
+    }
+    return cal;
+}
+
+// Adds a sample of the field at the given heading, level, as read by a
+// device whose true offsets are off[].  Returns magcal_add()'s result.
+static uint8_t add_level(double heading, const int16_t off[3]) {
+    double h = field * cos(dip);
+    double m[3] = { h * cos(heading), -h * sin(heading), field * sin(dip) };
+    int16_t raw[3];
+    for (int i = 0; i < 3; i++) {
+        raw[i] = (int16_t) lround(m[i] * LSM303_CAL_ONE / scale[i]) + off[i] + noise(2);
+    }
+    return magcal_add(raw[0], raw[1], raw[2]);
+}
+
+// the heading turn() has got to
+static double heading_deg = 0;
+
+// Turns on round at deg_per_s for the given time, and returns the number
+// of accepted fits that changed the offsets
+static int turn(double deg_per_s, double seconds, const int16_t off[3]) {
+    int changes = 0;
+    int n = lround(seconds * sample_hz);
+    for (int i = 0; i < n; i++) {
+        heading_deg = fmod(heading_deg + deg_per_s / sample_hz, 360);
+        changes += add_level(heading_deg * DEG_TO_RAD, off);
+    }
+    return changes;
+}
+
+// The largest horizontal error of the estimate against off[]
+static int horizontal_error(const int16_t off[3]) {
+    int16_t est[3];
+    magcal_offsets(est);
+    return max(abs(est[0] - off[0]), abs(est[1] - off[1]));
+}
+
+static int16_t vertical_offset() {
+    int16_t est[3];
+    magcal_offsets(est);
+    return est[2];
+}
+
+int main() {
+    const int16_t start[3] = { 0, 0, 10 };
+    const int16_t truth[3] = { 60, -40, 25 };
+
+    // Turning round once every 20 s: the horizontal offsets converge and
+    // the vertical one, which a level turn cannot see, stays put
+    lsm303_calibration cal = calibration(start[0], start[1], start[2]);
+    magcal_begin(&cal);
+    int changes = turn(18, 20, truth);
+    int after_20s = horizontal_error(truth);
+    changes += turn(18, 40, truth);
+    int after_60s = horizontal_error(truth);
+    CHECK(changes > 0);
+    CHECK(after_20s <= 10);
+    CHECK(after_60s <= 3);
+    CHECK(vertical_offset() == start[2]);
+
+    // the radius takes up the vertical offset it could not see
+    double seen_z = field * sin(dip) + (truth[2] - start[2]) *
+        (double) scale[2] / LSM303_CAL_ONE;
+    double seen_r = sqrt(sq(field * cos(dip)) + sq(seen_z));
+    CHECK(abs(magcal_radius - seen_r) < 5);
+    printf("level turn: horizontal offsets within %d after 20 s, %d after 60 s,"
+            " vertical kept at %d, radius %d\n",
+            after_20s, after_60s, vertical_offset(), magcal_radius);
+
+    // Moved into another case: the new offsets take over as the old
+    // samples are forgotten.  The fit remembers about 1000 samples, 33 s,
+    // so half the change should be made in about 23 s and all but 3 of
+    // it in under 3 minutes.
+    const int16_t moved[3] = { -30, 20, 25 };
+    int change = max(abs(moved[0] - truth[0]), abs(moved[1] - truth[1]));
+    int half_s = 0, follow_s = 0;
+    while (follow_s < 300 && horizontal_error(moved) > 3) {
+        turn(18, 1, moved);
+        follow_s++;
+        if (!half_s && horizontal_error(moved) <= change / 2) {
+            half_s = follow_s;
+        }
+    }
+    CHECK(half_s >= 15 && half_s <= 30);
+    CHECK(follow_s < 180);
+    CHECK(vertical_offset() == start[2]);
+    printf("offsets changed by %d: followed half way in %d s, within 3 in %d s\n",
+            change, half_s, follow_s);
+
+    // Walking straight on, heading wobbling 15 degrees either way, has
+    // too little spread to fit
+    magcal_begin(&cal);
+    int wobble_changes = 0;
+    for (int i = 0; i < 60 * sample_hz; i++) {
+        double heading = (40 + 15 * sin(i / sample_hz * 2)) * DEG_TO_RAD;
+        wobble_changes += add_level(heading, truth);
+    }
+    CHECK(wobble_changes == 0);
+    CHECK(horizontal_error(start) == 0 && vertical_offset() == start[2]);
+    CHECK(magcal_radius == 0);
+
+    // Samples along one axis only
+    magcal_begin(&cal);
+    int axis_changes = 0;
+    for (int i = 0; i < 60 * sample_hz; i++) {
+        axis_changes += magcal_add(truth[0] + lround(300 * sin(i / sample_hz)),
+                truth[1] + noise(2), truth[2] + 400);
+    }
+    CHECK(axis_changes == 0);
+    CHECK(horizontal_error(start) == 0 && vertical_offset() == start[2]);
+    CHECK(magcal_radius == 0);
+
+    // The same sample over and over, as from a stuck sensor
+    magcal_begin(&cal);
+    int point_changes = 0;
+    for (int i = 0; i < 60 * sample_hz; i++) {
+        point_changes += magcal_add(truth[0] + 100, truth[1], truth[2] + 400);
+    }
+    CHECK(point_changes == 0);
+    CHECK(horizontal_error(start) == 0 && vertical_offset() == start[2]);
+    CHECK(magcal_radius == 0);
+
+    return check_done("test_magcal");
+}
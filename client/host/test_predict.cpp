@@ -0,0 +1,164 @@
+/*
+ The position predictor, replaying gps_fake_data.h with a fix every
+ second and a query every 20 ms.  The trace is taken to move in a
+ straight line between its points, and the prediction is compared with
+ that and with holding the last fix.  Without a GPS speed the prediction
+ must be the last fix as given, and standing still it must not drift.
+ */
+
+#include <Arduino.h>
+#include "predict.h"
+#include "TinyGPS.h"
+#include "gps_fake_data.h"
+#include "check.h"
+
+static int32_t trace_lat[fd_len], trace_lon[fd_len];
+
+// Decodes the trace as GTPA010::fakeData() does
+static void read_trace() {
+    const uint8_t *p = fd_stream;
+    int32_t lat = 0, lon = 0;
+    for (int i = 0; i < fd_len; i++) {
+        for (int j = 0; j < 2; j++) {
+            uint32_t z = 0;
+            uint8_t shift = 0, b;
+            do {
+                b = pgm_read_byte(p++);
+                z |= (uint32_t) (b & 0x7F) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            int32_t d = (int32_t) (z >> 1) ^ -(int32_t) (z & 1);
+            if (j == 0) {
+                trace_lat[i] = lat += d;
+            } else {
+                trace_lon[i] = lon += d;
+            }
+        }
+    }
+}
+
+// metres per map unit of latitude, and of longitude at the trace
+static const double unit_m = 1.1132;
+static double unit_lon_m;
+
+static double distance_m(double dlat, double dlon) {
+    return hypot(dlat * unit_m, dlon * unit_lon_m);
+}
+
+// a repeatable random number of map units in [-n, n]
+static int32_t noise(int n) {
+    static uint32_t x = 1;
+    x = x * 1103515245 + 12345;
+    return (int32_t) ((x >> 16) % (2 * n + 1)) - n;
+}
+
+// Each run starts this far after the last so the predictor resets
+static uint32_t run_start = 1000;
+
+struct result {
+    double mean, max;           // prediction against the trace
+    double hold_mean, hold_max; // last fix against the trace
+    int same_as_fix;            // queries that gave the last fix
+    int queries;
+};
+
+// Replays the trace once.  A receiver measures the speed and course at
+// the moment of the fix, which here is the way to the next point.
+static result replay(bool with_speed, int noise_units) {
+    result r = { 0, 0, 0, 0, 0, 0 };
+    uint32_t t0 = run_start;
+    int32_t fix_lat = 0, fix_lon = 0;
+
+    for (int i = 0; i < fd_len - 1; i++) {
+        uint32_t speed = TinyGPS::GPS_INVALID_SPEED;
+        uint32_t course = TinyGPS::GPS_INVALID_ANGLE;
+        int16_t heading = 0;
+        if (with_speed) {
+            double dlat = trace_lat[i + 1] - trace_lat[i];
+            double dlon = trace_lon[i + 1] - trace_lon[i];
+            speed = lround(distance_m(dlat, dlon) / 0.5144 * 100);
+            double c = atan2(dlon * unit_lon_m, dlat * unit_m) * 180 / M_PI;
+            if (c < 0) {
+                c += 360;
+            }
+            course = lround(c * 100) % 36000;
+            heading = lround(c) % 360;
+        }
+        fix_lat = trace_lat[i] + noise(noise_units);
+        fix_lon = trace_lon[i] + noise(noise_units);
+        predict_fix(fix_lat, fix_lon, t0 + i * 1000, speed, course, heading);
+
+        for (int k = 0; k < 50; k++) {
+            int32_t lat, lon;
+            CHECK(predict_position(t0 + i * 1000 + k * 20, &lat, &lon));
+            double f = k / 50.0;
+            double true_lat = trace_lat[i] + f * (trace_lat[i + 1] - trace_lat[i]);
+            double true_lon = trace_lon[i] + f * (trace_lon[i + 1] - trace_lon[i]);
+            double e = distance_m(lat - true_lat, lon - true_lon);
+            double h = distance_m(fix_lat - true_lat, fix_lon - true_lon);
+            r.mean += e;
+            r.max = max(r.max, e);
+            r.hold_mean += h;
+            r.hold_max = max(r.hold_max, h);
+            r.same_as_fix += lat == fix_lat && lon == fix_lon;
+            r.queries++;
+        }
+    }
+    r.mean /= r.queries;
+    r.hold_mean /= r.queries;
+    run_start += fd_len * 1000 + 2 * PREDICT_RESET_AGE;
+    return r;
+}
+
+// Stands still for ten minutes with noisy fixes and a zero GPS speed.
+// Returns the furthest the prediction got from the true point, in units.
+static int32_t stand_still(int noise_units) {
+    const int32_t lat = trace_lat[0], lon = trace_lon[0];
+    int32_t worst = 0;
+    for (int i = 0; i < 600; i++) {
+        uint32_t t = run_start + i * 1000;
+        predict_fix(lat + noise(noise_units), lon + noise(noise_units), t,
+                    0, TinyGPS::GPS_INVALID_ANGLE, i % 360);
+        for (int k = 0; k < 50; k++) {
+            int32_t plat, plon;
+            predict_position(t + k * 20, &plat, &plon);
+            worst = max(worst, max(abs(plat - lat), abs(plon - lon)));
+        }
+    }
+    run_start += 600 * 1000 + 2 * PREDICT_RESET_AGE;
+    return worst;
+}
+
+static void print_result(const char *name, const result &r) {
+    printf("%-26s %4.1f / %3.0f m (hold last fix %4.1f / %3.0f m)\n",
+           name, r.mean, r.max, r.hold_mean, r.hold_max);
+}
+
+int main() {
+    read_trace();
+    unit_lon_m = unit_m * cos(trace_lat[0] * 1e-5 * M_PI / 180);
+
+    int32_t lat, lon;
+    CHECK(!predict_position(0, &lat, &lon));
+
+    printf("fixes at 1 Hz, queries at 50 Hz, mean / max error:\n");
+    result clean = replay(true, 0);
+    print_result("with speed, no noise:", clean);
+    CHECK(clean.mean < 0.6 * clean.hold_mean);
+    CHECK(clean.max <= clean.hold_max);
+
+    result noisy = replay(true, 2);
+    print_result("with speed, 2 unit noise:", noisy);
+    CHECK(noisy.mean < 0.7 * noisy.hold_mean);
+
+    // without a speed nothing is extrapolated
+    result no_speed = replay(false, 2);
+    print_result("no speed:", no_speed);
+    CHECK(no_speed.same_as_fix == no_speed.queries);
+
+    int32_t still = stand_still(3);
+    printf("standing still, 3 unit noise: within %ld units\n", (long) still);
+    CHECK(still <= 3);
+
+    return check_done("test_predict");
+}
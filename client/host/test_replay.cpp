@@ -0,0 +1,89 @@
+/*
+ GTPA010's replay of a recorded log, built with REPLAY_GPS_DATA and fed
+ gpslog.txt from this directory through the SD card.  readData() is
+ called every 50 ms, as the scheduler would, and every fix it publishes
+ is recorded: each logged second must come out one second after the one
+ before, with its GGA and RMC decoded by TinyGPS::encode(), across the
+ midnight in the log and on into the next pass when the log starts over.
+ */
+
+#include <Arduino.h>
+#include <SD.h>
+#include "GTPA010.h"
+#include "TinyGPS.h"
+#include "check.h"
+
+TinyGPS gps;
+
+// the log: 10 seconds from 23:59:56 with a GGA, GSA and RMC each
+static const int log_seconds = 10;
+static const long log_start_s = (23 * 60 + 59) * 60L + 56;
+
+static const unsigned long poll_ms = 50;
+
+static const int max_fixes = 64;
+static struct {
+    unsigned long at;
+    gpsData data;
+} fixes[max_fixes];
+static int fix_count = 0;
+
+int main() {
+    if (!host_sd_load(GPS_REPLAY_FILE, "gpslog.txt")) {
+        printf("test_replay: no gpslog.txt, run it from client/host\n");
+        return 1;
+    }
+
+    // two and a half times through the log
+    delay(1000);
+    unsigned long last = GTPA010::fixCount();
+    bool lock_held = true;
+    while (millis() < 26000) {
+        GTPA010::readData();
+        if (GTPA010::fixCount() != last) {
+            // one call publishes the GGA and the RMC of a second together
+            CHECK(GTPA010::fixCount() - last == 2);
+            last = GTPA010::fixCount();
+            if (fix_count < max_fixes) {
+                fixes[fix_count].at = millis();
+                fixes[fix_count].data = *GTPA010::getData();
+                fix_count++;
+            }
+            CHECK(GTPA010::lastFixTime() == millis());
+        }
+        if (fix_count > 0 && !GTPA010::gpsLock) {
+            lock_held = false;
+        }
+        delay(poll_ms);
+    }
+
+    CHECK(fix_count >= 2 * log_seconds + 2);
+    CHECK(lock_held);
+
+    unsigned long start = fixes[0].at;
+    unsigned long worst = 0;
+    for (int i = 0; i < fix_count; i++) {
+        int k = i % log_seconds;
+        const gpsData &d = fixes[i].data;
+
+        // the logged time and date, through midnight into the 20th
+        long s = (log_start_s + k) % 86400;
+        CHECK(d.hour == s / 3600 && d.minute == s / 60 % 60 && d.second == s % 60);
+        CHECK(d.day == (k < 4 ? 19 : 20) && d.month == 10 && d.year == 2026);
+
+        // each pass gives the same positions, and they move north
+        CHECK(d.lat == fixes[k].data.lat && d.lon == fixes[k].data.lon);
+        if (k > 0) {
+            CHECK(d.lat > fixes[i - 1].data.lat);
+        }
+
+        // a second apart to the poll, the next pass a second after the last
+        unsigned long due = start + 1000UL * i;
+        CHECK(fixes[i].at >= due && fixes[i].at < due + poll_ms);
+        worst = max(worst, fixes[i].at - due);
+    }
+
+    printf("replayed %d seconds of log in %lu ms, worst %lu ms late\n",
+            fix_count, fixes[fix_count - 1].at - start, worst);
+    return check_done("test_replay");
+}
@@ -0,0 +1,163 @@
+/*
+ lcd_image_draw_rotated() at all 24 steps of the heading-up map: every
+ screen pixel is within 1 pixel of where a float rotation puts it, the
+ background only shows where the screen runs off the image, and a frame
+ drawn in 16-row bands is the same as one drawn whole.  Prints the card
+ seeks per frame, and the time per frame on the host from the
+ draw_rotated profile stage.
+
+ Also erases a heading-up GPS dot at the top left corner of the screen,
+ where the square under the dot runs off the window.
+ */
+
+#include <Arduino.h>
+#include <Adafruit_ST7735.h>
+#include <SD.h>
+#include "lcd_image.h"
+#include "map.h"
+#include "LSM303.h"
+#include "GTPA010.h"
+#define PROFILE
+#include "profile.h"
+#include "check.h"
+
+// small enough that each pixel's color is its row and column
+static const uint16_t image_cols = 256, image_rows = 240;
+static uint8_t image[image_rows * image_cols * 2];
+static const uint16_t background = 0xFFFF;
+
+static const int16_t width = ST7735_TFTWIDTH, height = ST7735_TFTHEIGHT;
+
+// what map.cpp uses from client.cpp and the drivers
+Adafruit_ST7735 tft(0, 0, 0);
+LSM303 compass;
+extern uint16_t gps_map_x, gps_map_y;
+
+gpsData *GTPA010::getData() {
+    static gpsData data;
+    return &data;
+}
+
+extern "C" uint8_t twi_submitRead(twi_request *req) {
+    req->status = TWI_REQ_ERROR;
+    return 1;
+}
+
+extern "C" void twi_cancelRead(twi_request *req) {}
+
+// the map 0 tile, which map.cpp reads as yeg-1.lcd
+static uint8_t map_image[512 * 512 * 2];
+
+// Erases a heading-up dot at screen_x, screen_y, and returns the number
+// of pixels drawn outside the window's part of the square under it
+static int check_erase(int16_t screen_x, int16_t screen_y) {
+    const uint16_t untouched = 0x1234;
+    map_heading_up = 1;
+    map_rotation = 0;
+    current_map_num = 0;
+    screen_map_x = 200;
+    screen_map_y = 200;
+    gps_map_x = screen_map_x + screen_x;
+    gps_map_y = screen_map_y + screen_y;
+
+    uint16_t x, y;
+    CHECK(get_gps_screen_x_y(&x, &y) && x == screen_x && y == screen_y);
+
+    tft.fillScreen(untouched);
+    erase_gps();
+
+    int wrong = 0;
+    for (int j = 0; j < height; j++) {
+        for (int i = 0; i < width; i++) {
+            bool under = abs(i - screen_x) <= (int) dot_radius &&
+                         abs(j - screen_y) <= (int) dot_radius;
+            wrong += (host_screen[j][i] != untouched) != under;
+        }
+    }
+    return wrong;
+}
+static lcd_image_t tile = { (char *) "tile.lcd", image_cols, image_rows };
+
+static uint16_t frame[ST7735_TFTHEIGHT][ST7735_TFTWIDTH];
+
+// Checks the screen against the float rotation about icol, irow at the
+// middle of the screen, and returns the number of wrong pixels
+static int check_frame(int32_t icol, int32_t irow, int16_t angle) {
+    double c = cos(angle * M_PI / 180), s = sin(angle * M_PI / 180);
+    int wrong = 0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            double u = x - width / 2, v = y - height / 2;
+            double ix = icol + u * c - v * s;
+            double iy = irow + u * s + v * c;
+            uint16_t p = host_screen[y][x];
+            if (p == background) {
+                // somewhere within a pixel has to be off the image
+                wrong += ix >= 1 && ix < image_cols - 2 &&
+                         iy >= 1 && iy < image_rows - 2;
+            } else {
+                wrong += fabs((p >> 8) - iy) > 1 || fabs((p & 0xFF) - ix) > 1;
+            }
+        }
+    }
+    return wrong;
+}
+
+int main() {
+    for (uint32_t row = 0; row < image_rows; row++) {
+        for (uint32_t col = 0; col < image_cols; col++) {
+            uint16_t p = row << 8 | col;
+            image[(row * image_cols + col) * 2] = p >> 8;
+            image[(row * image_cols + col) * 2 + 1] = p & 0xFF;
+        }
+    }
+    host_sd_add(tile.file_name, image, sizeof(image));
+
+    // the middle of the image, then near a corner so the edges show
+    const int32_t pivots[][2] = { { 128, 120 }, { 20, 30 }, { 240, 220 } };
+    uint32_t min_seeks = 0xFFFFFFFF, max_seeks = 0;
+
+    for (int p = 0; p < 3; p++) {
+        int32_t icol = pivots[p][0], irow = pivots[p][1];
+        for (int16_t angle = 0; angle < 360; angle += 15) {
+            uint32_t seeks = host_sd_seeks;
+            PROFILE_BEGIN(DRAW_ROTATED);
+            lcd_image_draw_rotated(&tile, &tft, icol, irow,
+                                   width / 2, height / 2, 0, 0,
+                                   width, height, angle, background);
+            PROFILE_END(DRAW_ROTATED);
+            min_seeks = min(min_seeks, host_sd_seeks - seeks);
+            max_seeks = max(max_seeks, host_sd_seeks - seeks);
+
+            int wrong = check_frame(icol, irow, angle);
+            if (wrong) {
+                printf("pivot %ld,%ld angle %d: %d pixels wrong\n",
+                       (long) icol, (long) irow, angle, wrong);
+            }
+            CHECK(wrong == 0);
+
+            // the same frame a band at a time, as draw_map_refine() does
+            memcpy(frame, host_screen, sizeof(frame));
+            tft.fillScreen(0);
+            for (int16_t band = 0; band < height; band += 16) {
+                lcd_image_draw_rotated(&tile, &tft, icol, irow,
+                                       width / 2, height / 2, 0, band,
+                                       width, 16, angle, background);
+            }
+            CHECK(memcmp(frame, host_screen, sizeof(frame)) == 0);
+        }
+    }
+
+    printf("%lu-%lu card seeks per frame, against %d for a north up "
+           "frame\n", (unsigned long) min_seeks, (unsigned long) max_seeks,
+           height);
+    profile_report();
+
+    host_sd_add("yeg-1.lcd", map_image, sizeof(map_image));
+    CHECK(check_erase(1, 1) == 0);
+    CHECK(check_erase(1, 80) == 0);
+    CHECK(check_erase(64, 1) == 0);
+    CHECK(check_erase(127, 159) == 0);
+
+    return check_done("test_rotated");
+}
@@ -0,0 +1,80 @@
+/*
+ lcd_image_draw_scaled(): every screen pixel it draws is the image pixel
+ under it, blown up by the scale, nothing outside the window is touched,
+ and only width/scale by height/scale pixels are read from the card.
+ */
+
+#include <Arduino.h>
+#include <Adafruit_ST7735.h>
+#include <SD.h>
+#include "lcd_image.h"
+#include "check.h"
+
+static const uint16_t image_cols = 600, image_rows = 500;
+static uint8_t image[image_rows * image_cols * 2];
+
+// a different color for nearly every pixel
+static uint16_t image_pixel(uint32_t row, uint32_t col) {
+    return (row * 251 + col * 7919) ^ (row << 5);
+}
+
+static const uint16_t untouched = 0x1234;
+
+static Adafruit_ST7735 tft(0, 0, 0);
+static lcd_image_t tile = { (char *) "tile.lcd", image_cols, image_rows };
+
+static void check_draw(uint16_t icol, uint16_t irow, uint16_t scol,
+    uint16_t srow, uint16_t width, uint16_t height, uint8_t scale) {
+    tft.fillScreen(untouched);
+    uint32_t bytes = host_sd_bytes;
+    uint32_t pushes = host_screen_pushes;
+
+    lcd_image_draw_scaled(&tile, &tft, icol, irow, scol, srow,
+                          width, height, scale);
+
+    CHECK(host_sd_bytes - bytes == 2UL * (width / scale) * (height / scale));
+    CHECK(host_screen_pushes - pushes == (uint32_t) width * height);
+
+    int wrong = 0;
+    for (int y = 0; y < ST7735_TFTHEIGHT; y++) {
+        for (int x = 0; x < ST7735_TFTWIDTH; x++) {
+            uint16_t expect = untouched;
+            if (x >= scol && x < scol + width && y >= srow && y < srow + height) {
+                expect = image_pixel(irow + (y - srow) / scale,
+                                     icol + (x - scol) / scale);
+            }
+            wrong += host_screen[y][x] != expect;
+        }
+    }
+    if (wrong) {
+        printf("scale %u at image %u,%u: %d pixels wrong\n",
+               scale, icol, irow, wrong);
+    }
+    CHECK(wrong == 0);
+}
+
+int main() {
+    // the pixel bytes are the other way round on the card
+    for (uint32_t row = 0; row < image_rows; row++) {
+        for (uint32_t col = 0; col < image_cols; col++) {
+            uint16_t p = image_pixel(row, col);
+            image[(row * image_cols + col) * 2] = p >> 8;
+            image[(row * image_cols + col) * 2 + 1] = p & 0xFF;
+        }
+    }
+    host_sd_add(tile.file_name, image, sizeof(image));
+
+    // the previews one and two zoom levels in, and a part of the screen
+    check_draw(0, 0, 0, 0, 128, 160, 2);
+    check_draw(image_cols - 64, image_rows - 80, 0, 0, 128, 160, 2);
+    check_draw(301, 177, 0, 0, 128, 160, 4);
+    check_draw(10, 20, 8, 16, 96, 64, 4);
+    check_draw(45, 67, 3, 5, 120, 150, 1);
+
+    uint32_t bytes = host_sd_bytes;
+    check_draw(123, 321, 0, 0, 128, 160, 2);
+    printf("preview one level in reads %lu bytes\n",
+           (unsigned long) (host_sd_bytes - bytes));
+
+    return check_done("test_scaled");
+}
@@ -0,0 +1,143 @@
+/*
+ The main loop's scheduler, with tasks that take the time the test gives
+ them: due tasks run most overdue first and once per pass, tasks that are
+ not due wait, a task kept to time stays on its period, a run over budget
+ counts as an overrun and a missed period as late, and the worst time is
+ reported in full however long it was.
+ */
+
+#include <Arduino.h>
+#include "sched.h"
+#include "check.h"
+
+// the order tasks ran in this pass, one letter each
+static char order[32];
+static int order_length = 0;
+
+// how long each task's next run takes
+static uint32_t take_us[4];
+
+static void run(int task) {
+    if (order_length < (int) sizeof(order) - 1) {
+        order[order_length++] = 'a' + task;
+        order[order_length] = '\0';
+    }
+    host_now_us += take_us[task];
+}
+
+static void task_a() { run(0); }
+static void task_b() { run(1); }
+static void task_c() { run(2); }
+static void task_d() { run(3); }
+
+// fills the table without getting in the way
+static void idle() {}
+
+// runs one pass at the given time, and returns the order the tasks ran in
+static const char *pass_at(uint32_t ms) {
+    host_now_us = (uint64_t) ms * 1000;
+    order_length = 0;
+    order[0] = '\0';
+    sched_run();
+    return order;
+}
+
+// sched_report()'s counts for each task
+static struct {
+    unsigned runs, overruns, budget, late;
+    unsigned long worst;
+} report[4];
+static int reported = 0;
+
+static void report_line(const char *line) {
+    char name[16];
+    if (reported < 4 &&
+            sscanf(line, "%15[^:]: %u runs, %u over %u us, %u late, worst %lu us",
+                name, &report[reported].runs, &report[reported].overruns,
+                &report[reported].budget, &report[reported].late,
+                &report[reported].worst) == 6) {
+        reported++;
+    }
+}
+
+static void get_report() {
+    reported = 0;
+    sched_report();
+    CHECK(reported == 4);
+}
+
+int main() {
+    host_serial_line = report_line;
+
+    // a every 10 ms, b every 20, c every pass, d every 100 ms
+    CHECK(sched_add("a", task_a, 10, 1000) == 0);
+    CHECK(sched_add("b", task_b, 20, 1000) == 1);
+    CHECK(sched_add("c", task_c, 0, 1000) == 2);
+    CHECK(sched_add("d", task_d, 100, 20000) == 3);
+    for (int i = 4; i < SCHED_MAX_TASKS; i++) {
+        CHECK(sched_add("idle", idle, 60000, 1000) == i);
+    }
+    CHECK(sched_add("full", idle, 1000, 1000) == -1);
+
+    // All due at once at the start, in the order they were added, and
+    // each runs once although c is still due after it has run
+    CHECK(strcmp(pass_at(0), "abcd") == 0);
+
+    // Only the ones that are due, c every pass
+    CHECK(strcmp(pass_at(5), "c") == 0);
+
+    // Most overdue first: c was due at 5, a at 10
+    CHECK(strcmp(pass_at(10), "ca") == 0);
+
+    // c was due at 10, a and b at 20, and a was added first
+    CHECK(strcmp(pass_at(25), "cab") == 0);
+
+    // A task kept to time stays on its period, even when the loop only
+    // comes round a few ms after it is due: a at 30, 40, ... 1090, b at
+    // 40, 60, ... 1080, d at 100, 200, ... 1000
+    get_report();
+    int passes = 0;
+    for (uint32_t ms = 30; ms < 1100; ms += 7) {
+        pass_at(ms);
+        passes++;
+    }
+    get_report();
+    CHECK(report[0].runs == 107 && report[0].late == 0);
+    CHECK(report[1].runs == 53 && report[1].late == 0);
+    CHECK(report[2].runs == passes && report[2].late == 0);
+    CHECK(report[3].runs == 10 && report[3].late == 0);
+    CHECK(report[0].overruns == 0 && report[3].overruns == 0);
+
+    // d taking 30 ms at 1100, over its 20 ms budget, makes a miss a whole
+    // period and b half of one: d is an overrun, a is late and skips
+    // ahead to 1141, b keeps to 1140
+    take_us[3] = 30000;
+    CHECK(strcmp(pass_at(1100), "cabd") == 0);
+    take_us[3] = 0;
+    CHECK(strcmp(pass_at(1131), "cab") == 0);
+    CHECK(strcmp(pass_at(1136), "c") == 0);
+    CHECK(strcmp(pass_at(1140), "cb") == 0);
+    CHECK(strcmp(pass_at(1141), "ca") == 0);
+    get_report();
+    CHECK(report[3].overruns == 1 && report[3].late == 0);
+    CHECK(report[0].late == 1 && report[0].overruns == 0);
+    CHECK(report[1].late == 0);
+    CHECK(report[3].worst == 30000);
+
+    // A redraw can take longer than 65535 us, and the report must say so
+    take_us[3] = 150000;
+    pass_at(1200);
+    take_us[3] = 0;
+    get_report();
+    unsigned long longest = report[3].worst;
+    CHECK(longest == 150000);
+    CHECK(report[3].overruns == 1);
+
+    // and the report starts the counts over
+    get_report();
+    CHECK(report[0].runs == 0 && report[3].worst == 0);
+
+    printf("%d passes in deadline order, a %lu us run reported as %lu us\n",
+            passes, 150000UL, longest);
+    return check_done("test_sched");
+}
@@ -0,0 +1,104 @@
+/*
+ serial_read_int(): the values it accepts and rejects, where it leaves the
+ stream, its timeout, and that it parses a path reply the same as
+ serial_readline(), string_read_field() and string_get_int() did.
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#include "serial_handling.h"
+#include "check.h"
+
+static const int32_t untouched = 777;
+
+// Reads one integer from text, then checks the next one is 12 when the
+// text has one, to see that the first read stopped in the right place.
+static void check_read(const char *text, uint8_t status, int32_t value,
+    uint8_t then_12) {
+    host_serial_input(text, strlen(text));
+    int32_t v = untouched;
+    uint8_t s = serial_read_int(&v, 100);
+    if (s != status || v != value) {
+        printf("'%s': got status %u value %ld\n", text, s, (long) v);
+    }
+    CHECK(s == status && v == value);
+    if (then_12) {
+        v = untouched;
+        CHECK(serial_read_int(&v, 100) == SERIAL_INT_OK && v == 12);
+    }
+}
+
+static double now_s() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+int main() {
+    // every wait on the serial port moves the clock on
+    host_tick_us = 10;
+
+    check_read("0 ", SERIAL_INT_OK, 0, 0);
+    check_read("5352706 12\n", SERIAL_INT_OK, 5352706, 1);
+    check_read("-11353058\r\n12\r\n", SERIAL_INT_OK, -11353058, 1);
+    check_read(" \r\n  +42 12 ", SERIAL_INT_OK, 42, 1);
+    check_read("-0 ", SERIAL_INT_OK, 0, 0);
+    check_read("2147483647 ", SERIAL_INT_OK, 2147483647, 0);
+    check_read("-2147483648 ", SERIAL_INT_OK, -2147483647 - 1, 0);
+
+    // too big: the rest of the number is still used up
+    check_read("2147483648 12 ", SERIAL_INT_BAD, untouched, 1);
+    check_read("-2147483649 12 ", SERIAL_INT_BAD, untouched, 1);
+    check_read("99999999999999999999 12\n", SERIAL_INT_BAD, untouched, 1);
+
+    // no digits
+    check_read("x ", SERIAL_INT_BAD, untouched, 0);
+    check_read("- 12 ", SERIAL_INT_BAD, untouched, 1);
+
+    // nothing, or a number the server never finished
+    uint64_t start = host_now_us;
+    check_read("", SERIAL_INT_TIMEOUT, untouched, 0);
+    uint64_t waited = (host_now_us - start) / 1000;
+    // millis() counts whole ms, so the wait can start just before one ends
+    CHECK(waited >= 99 && waited < 110);
+    check_read("123", SERIAL_INT_TIMEOUT, untouched, 0);
+
+    // A long path reply, read both ways
+    const int lines = 100000;
+    static char text[lines * 24];
+    size_t n = 0;
+    for (int i = 0; i < lines; i++) {
+        n += sprintf(text + n, "%ld %ld\n", 5352706L + i % 1000,
+                     -11353058L - i % 977);
+    }
+
+    host_serial_input(text, n);
+    double t0 = now_s();
+    int64_t old_sum = 0;
+    for (int i = 0; i < lines; i++) {
+        char line[40], field[20];
+        serial_readline(line, sizeof(line));
+        uint16_t pos = string_read_field(line, 0, field, sizeof(field), " ");
+        old_sum += string_get_int(field) * (int64_t) (i + 1);
+        string_read_field(line, pos, field, sizeof(field), " ");
+        old_sum += string_get_int(field) * (int64_t) (i + 1);
+    }
+    double t1 = now_s();
+
+    host_serial_input(text, n);
+    int64_t new_sum = 0;
+    for (int i = 0; i < lines; i++) {
+        int32_t lat = 0, lon = 0;
+        CHECK(serial_read_int(&lat, 1000) == SERIAL_INT_OK);
+        CHECK(serial_read_int(&lon, 1000) == SERIAL_INT_OK);
+        new_sum += (lat + (int64_t) lon) * (i + 1);
+    }
+    double t2 = now_s();
+
+    CHECK(old_sum == new_sum);
+    printf("path reply: %.0f ns/line through serial_readline, "
+           "%.0f ns/line through serial_read_int (host)\n",
+           (t1 - t0) / lines * 1e9, (t2 - t1) / lines * 1e9);
+
+    return check_done("test_serial");
+}
@@ -0,0 +1,203 @@
+/*
+ TinyGPS with the sentence filter: an hour of the module's default output
+ (GGA, GSA, three GSV and RMC each second) decodes to the fixes it was
+ made from, sentences that are skipped or fail their checksum do not get
+ in the way, and the decoder's speed on the host.
+
+ The Makefile builds this three times: with the default filter (RMC and
+ GGA), as test_tinygps_all with every sentence parsed, and as
+ test_tinygps_rmc with RMC alone.
+ */
+
+#include <Arduino.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "TinyGPS.h"
+#include "check.h"
+
+#if !defined(_GPS_SENTENCE_FILTER)
+#define TEST_NAME "test_tinygps_all"
+#define DECODES_GGA 1
+#define DECODES_OTHERS 1
+#elif (_GPS_SENTENCE_FILTER) & _GPS_ACCEPT_GPGGA
+#define TEST_NAME "test_tinygps"
+#define DECODES_GGA 1
+#define DECODES_OTHERS 0
+#else
+#define TEST_NAME "test_tinygps_rmc"
+#define DECODES_GGA 0
+#define DECODES_OTHERS 0
+#endif
+
+// The fix sent each second.  Positions are whole degrees and 1/10000ths
+// of a minute, as the module sends them.
+typedef struct {
+    long lat_deg, lat_tenk;
+    long lon_deg, lon_tenk;
+    unsigned long speed;    // 1/100 knot
+    unsigned long course;   // 1/100 degree
+} fix_t;
+
+static const int seconds = 3600;
+static fix_t fixes[seconds];
+
+static char log_text[seconds * 420];
+static size_t log_length = 0;
+
+// Appends $body*XX and CR LF, with the checksum spoilt if bad is set
+static void sentence(const char *body, bool bad) {
+    uint8_t sum = 0;
+    for (const char *p = body; *p; p++) {
+        sum ^= *p;
+    }
+    if (bad) {
+        sum ^= 0x55;
+    }
+    log_length += sprintf(log_text + log_length, "$%s*%02X\r\n", body, sum);
+}
+
+// What parse_degrees() makes of a position
+static long degrees_e5(long deg, long tenk) {
+    return deg * 100000 + tenk / 6;
+}
+
+// Which second's RMC is sent with a bad checksum
+static bool bad_rmc(int s) {
+    return s % 97 == 50;
+}
+
+// Which seconds' three GSV are sent with bad checksums
+static bool bad_gsv(int s) {
+    return s % 10 == 0;
+}
+
+// The host's cycle counter, or 0 where there is none
+static uint64_t cycles() {
+#if defined(__i386__) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+int main() {
+    for (int s = 0; s < seconds; s++) {
+        fix_t *f = &fixes[s];
+        long lat = 53L * 600000 + 31 * 10000 + s * 37 % 50000;
+        long lon = 113L * 600000 + 31 * 10000 + s * 53 % 50000;
+        f->lat_deg = lat / 600000;
+        f->lat_tenk = lat % 600000;
+        f->lon_deg = lon / 600000;
+        f->lon_tenk = lon % 600000;
+        f->speed = s * 7 % 3000;
+        f->course = s * 1234 % 36000;
+
+        char lat_s[48], lon_s[48], time_s[48], body[256];
+        snprintf(lat_s, sizeof(lat_s), "%02ld%02ld.%04ld", f->lat_deg,
+                 f->lat_tenk / 10000, f->lat_tenk % 10000);
+        snprintf(lon_s, sizeof(lon_s), "%03ld%02ld.%04ld", f->lon_deg,
+                 f->lon_tenk / 10000, f->lon_tenk % 10000);
+        snprintf(time_s, sizeof(time_s), "%02d%02d%02d.000", 12 + s / 3600,
+                 s / 60 % 60, s % 60);
+
+        snprintf(body, sizeof(body),
+                 "GPGGA,%s,%s,N,%s,W,1,08,0.95,668.2,M,-17.4,M,,0000",
+                 time_s, lat_s, lon_s);
+        sentence(body, false);
+        sentence("GPGSA,A,3,10,07,05,02,29,04,08,13,,,,,1.72,1.03,1.38",
+                 false);
+        for (int i = 1; i <= 3; i++) {
+            snprintf(body, sizeof(body), "GPGSV,3,%d,11,10,63,137,17,07,61,"
+                     "098,15,05,59,290,20,08,54,157,30", i);
+            sentence(body, bad_gsv(s));
+        }
+        snprintf(body, sizeof(body),
+                 "GPRMC,%s,A,%s,N,%s,W,%lu.%02lu,%lu.%02lu,120598,,",
+                 time_s, lat_s, lon_s, f->speed / 100, f->speed % 100,
+                 f->course / 100, f->course % 100);
+        sentence(body, bad_rmc(s));
+    }
+
+    // Each RMC ends a second: the decoder must have that second's fix
+    TinyGPS gps;
+    int s = 0, good = 0, wrong = 0;
+    size_t start = 0;
+    for (size_t i = 0; i < log_length; i++) {
+        if (log_text[i] == '$') {
+            start = i;
+        }
+        if (gps.encode(log_text[i])) {
+            good++;
+        }
+        if (log_text[i] != '\n'
+            || strncmp(log_text + start, "$GPRMC", 6) != 0) {
+            continue;
+        }
+
+        // a bad RMC leaves the speed and course of the one before, and
+        // the position too unless GGA is decoded
+        long lat, lon;
+        gps.get_position(&lat, &lon);
+        fix_t *f = &fixes[s];
+        fix_t *r = bad_rmc(s) ? &fixes[s - 1] : f;
+        fix_t *p = DECODES_GGA ? f : r;
+        if (lat != degrees_e5(p->lat_deg, p->lat_tenk)
+            || lon != -degrees_e5(p->lon_deg, p->lon_tenk)) {
+            wrong++;
+        }
+        if (gps.speed() != r->speed || gps.course() != r->course) {
+            wrong++;
+        }
+        if (DECODES_GGA ? gps.hdop() != 95 || gps.fix_quality() != 1
+            : gps.hdop() != TinyGPS::GPS_INVALID_HDOP) {
+            wrong++;
+        }
+        s++;
+    }
+    CHECK(s == seconds);
+    CHECK(wrong == 0);
+
+    int bad_rmcs = 0, bad_gsvs = 0;
+    for (int i = 0; i < seconds; i++) {
+        bad_rmcs += bad_rmc(i);
+        bad_gsvs += 3 * bad_gsv(i);
+    }
+    // only RMC and GGA carry a fix, so only they count as good
+    CHECK(good == (DECODES_GGA ? 2 * seconds : seconds) - bad_rmcs);
+
+    // only the sentences that are decoded are checksummed
+    unsigned long chars;
+    unsigned short sentences, failed;
+    gps.stats(&chars, &sentences, &failed);
+    CHECK(chars == log_length);
+    CHECK(failed == bad_rmcs + (DECODES_OTHERS ? bad_gsvs : 0));
+
+    // decoder speed, for comparison only: the best of a few runs, as the
+    // host is busy with other things
+    const int runs = 5, passes = 10;
+    double best_secs = 1e9, best_cycles = 1e18;
+    for (int run = 0; run < runs; run++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        uint64_t c0 = cycles();
+        for (int p = 0; p < passes; p++) {
+            for (size_t i = 0; i < log_length; i++) {
+                gps.encode(log_text[i]);
+            }
+        }
+        uint64_t c1 = cycles();
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        best_secs = min(best_secs, (t1.tv_sec - t0.tv_sec)
+                        + (t1.tv_nsec - t0.tv_nsec) * 1e-9);
+        best_cycles = min(best_cycles, (double) (c1 - c0));
+    }
+    printf("%-17s %lu bytes, %d sentences: %6.1f MB/s, "
+           "%4.0f cycles/sentence (host)\n", TEST_NAME,
+           (unsigned long) log_length, seconds * 6,
+           log_length * passes / best_secs / 1e6,
+           best_cycles / passes / (seconds * 6));
+
+    return check_done(TEST_NAME);
+}
@@ -1,6 +1,8 @@
 #include <Arduino.h>
+#include <util/atomic.h>
 
 #include "joystick.h"
+#include "TimerThree.h"
 
 // Arduino analog input pin for the horizontal on the joystick.
 const uint8_t joy_pin_x = 0;
@@ -13,87 +15,147 @@ const uint8_t joy_pin_button = 4;
 int16_t joy_center_x = 512;
 int16_t joy_center_y = 512;
 
+// The joystick is sampled from Timer3 this often, in us.  The ADC
+// converts one axis between ticks, so both axes are read at half this
+// rate and the interrupt never waits on a conversion.
+const uint32_t joy_tick_us = 10000;
+
+// ticks the button has to hold a new state before it counts, and ticks
+// it has to stay down for a long press
+const uint8_t joy_debounce_ticks = 3;
+const uint8_t joy_long_ticks = 100;
+
+// slots kept free of moves so button events still fit when the loop has
+// fallen behind
+const uint8_t joy_button_reserve = 4;
+
+// Events, written only by interrupt handlers and read only by the loop.
+// The indices run freely and are masked on use; each side only writes its
+// own, after the slot itself, so no locking is needed.
+static volatile joy_event queue[JOY_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;     // next slot the interrupt fills
+static volatile uint8_t queue_tail = 0;     // next slot the loop reads
+static volatile uint16_t queue_dropped = 0;
+
+// the axis being converted, and the last reading of each
+static uint8_t adc_axis = 0;
+static int16_t axis_value[2];
+
+// debounced button state: 0 not pressed, 1 pressed
+static uint8_t button_state = 0;
+static uint8_t button_changing = 0;     // ticks the pin has disagreed
+static uint8_t button_held = 0;         // ticks held down, up to long
+
+// Starts converting the given analog pin.
+static void start_conversion(uint8_t pin) {
+    ADMUX = _BV(REFS0) | (pin & 0x07);
+    ADCSRA |= _BV(ADSC);
+}
 
-// button state: 0 not pressed, 1 pressed
-uint8_t prev_button_state = 0;
-
-// time of last sampling of button state
-uint32_t button_prev_time = 0;
-
-// only after this much time has passed is the state sampled.
-uint32_t button_sample_delay = 200;
-
-void initialize_joystick() {
-    // Initialize the button pin, turn on pullup resistor
-    pinMode(joy_pin_button, INPUT);
-    digitalWrite(joy_pin_button, HIGH);
+// Adds an event, unless fewer than reserve slots would be left after it.
+static void push_event(uint8_t type, int8_t dx, int8_t dy, uint8_t reserve) {
+    uint8_t used = queue_head - queue_tail;
+    if (used + reserve >= JOY_QUEUE_SIZE) {
+        queue_dropped++;
+        return;
+    }
+    volatile joy_event *e = &queue[queue_head & (JOY_QUEUE_SIZE - 1)];
+    e->type = type;
+    e->dx = dx;
+    e->dy = dy;
 
-    // Center Joystick
-    joy_center_x = analogRead(joy_pin_x);
-    joy_center_y = analogRead(joy_pin_y);
+    // publish the slot only once it is filled in
+    queue_head++;
 }
 
-
 /*
-  Read the joystick position, and return the x, y displacement from the zero
-  position.  The joystick has to be at least 4 units away from zero before a
-  non-zero displacement is returned.  This filters out the centering errors that
-  occur when the joystick is released.
-
-  Also, return 1 if the joystick button has been pushed, held for a minimum
-  amount of time, and then released.  That is, a 1 is returned if a button
-  select action has occurred.  
-
+  Timer3 interrupt: collect the axis converted since the last tick, start
+  the other, and when both are in report any displacement.  The
+  displacement has to be at least 4 units away from zero before it
+  counts, which filters out the centering errors that occur when the
+  joystick is released.
+
+  The button is debounced by requiring the same reading for a few ticks
+  in a row.
 */
-uint8_t process_joystick(int16_t *dx, int16_t *dy) {
-    int16_t joy_x;
-    int16_t joy_y;
-    uint8_t button_state;
-
-    joy_x = -(analogRead(joy_pin_y) - joy_center_x);
-    joy_y = -(analogRead(joy_pin_x) - joy_center_y);
+static void joystick_tick() {
+    axis_value[adc_axis] = ADC;
+    adc_axis ^= 1;
+    start_conversion(adc_axis ? joy_pin_y : joy_pin_x);
+
+    if (adc_axis == 0) {
+        int16_t joy_x = -(axis_value[1] - joy_center_x);
+        int16_t joy_y = -(axis_value[0] - joy_center_y);
+
+        if (abs(joy_x) <= 4) {
+            joy_x = 0;
+        }
+
+        if (abs(joy_y) <= 4) {
+            joy_y = 0;
+        }
+
+        int8_t dx = joy_x / 128;
+        int8_t dy = joy_y / 128;
+        if (dx != 0 || dy != 0) {
+            push_event(JOY_MOVE, dx, dy, joy_button_reserve);
+        }
+    }
 
-    if (abs(joy_x) <= 4) {
-        joy_x = 0;
+    uint8_t pressed = LOW == digitalRead(joy_pin_button);
+    if (pressed == button_state) {
+        button_changing = 0;
+    } else if (++button_changing >= joy_debounce_ticks) {
+        button_state = pressed;
+        button_changing = 0;
+        button_held = 0;
+        push_event(pressed ? JOY_PRESS : JOY_RELEASE, 0, 0, 0);
     }
 
-    if (abs(joy_y) <= 4) {
-        joy_y = 0;
+    if (button_state && button_held < joy_long_ticks &&
+        ++button_held == joy_long_ticks) {
+        push_event(JOY_LONG_PRESS, 0, 0, 0);
     }
+}
 
-    *dx = joy_x / 128;
-    *dy = joy_y / 128;
+void joystick_push_event(uint8_t type) {
+    push_event(type, 0, 0, 0);
+}
 
-    // first, don't even sample unless enough time has passed
-    uint8_t have_sample = 0;
-    uint32_t cur_time = millis();
-    if ( cur_time < button_prev_time ) {
-        // time inversion caused by wraparound, so reset
-        button_prev_time = cur_time;
-    }
-    if ( button_prev_time == 0 || 
-         button_prev_time + button_sample_delay < cur_time ) {
-        // button pushed after suitable delay, so ok to return state
-        button_prev_time = cur_time;
-        have_sample = 1;
-        button_state = LOW == digitalRead(joy_pin_button);
-    }
+void initialize_joystick() {
+    // Initialize the button pin, turn on pullup resistor
+    pinMode(joy_pin_button, INPUT);
+    digitalWrite(joy_pin_button, HIGH);
 
-    // if no sample, return no press result
-    if ( ! have_sample ) { return 0; }
+    // Center Joystick
+    joy_center_x = analogRead(joy_pin_x);
+    joy_center_y = analogRead(joy_pin_y);
 
-    // if prev and current state are same, no transition occurs
-    if ( prev_button_state == button_state ) { return 0; }
+    // From here on only the interrupt uses the ADC
+    adc_axis = 0;
+    start_conversion(joy_pin_x);
+    Timer3.initialize(joy_tick_us);
+    Timer3.attachInterrupt(joystick_tick);
+}
 
-    // are we waiting for push or release?
-    if ( prev_button_state ) {
-        // we got a release, return the press event
-        prev_button_state = button_state;
-        return 1;
+uint8_t joystick_event(joy_event *e) {
+    if (queue_tail == queue_head) {
+        return 0;
     }
+    volatile joy_event *slot = &queue[queue_tail & (JOY_QUEUE_SIZE - 1)];
+    e->type = slot->type;
+    e->dx = slot->dx;
+    e->dy = slot->dy;
+
+    // hand the slot back only once it has been copied
+    queue_tail++;
+    return 1;
+}
 
-    // we got a press, so change state to waiting for release, but
-    // don't signal the press event yet.
-    prev_button_state = button_state;
-    return 0;
+uint16_t joystick_dropped() {
+    uint16_t n;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        n = queue_dropped;
+    }
+    return n;
 }
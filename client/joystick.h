@@ -1,10 +1,52 @@
 #ifndef _JOY_H_
 #define _JOY_H_
 
+#include <stdint.h>
+
 extern int16_t joy_center_x;
 extern int16_t joy_center_y;
 
+// slots in the event queue, a power of 2
+#define JOY_QUEUE_SIZE 16
+
+// joystick event types
+#define JOY_MOVE 0          // stick away from the centre, by dx, dy
+#define JOY_PRESS 1         // button went down
+#define JOY_RELEASE 2       // button came back up
+#define JOY_LONG_PRESS 3    // button held down for a second
+#define JOY_ZOOM_IN 4       // zoom in button pushed
+#define JOY_ZOOM_OUT 5      // zoom out button pushed
+
+typedef struct {
+    uint8_t type;
+    int8_t dx;
+    int8_t dy;
+} joy_event;
+
+/*
+    Centres the joystick and starts sampling it from the Timer3 interrupt.
+*/
 void initialize_joystick();
-uint8_t process_joystick(int16_t *dx, int16_t *dy);
+
+/*
+    Takes the oldest event off the queue.  The queue is filled from the
+  timer interrupt, so presses made during a redraw or a path request
+  wait here instead of being lost.
+
+  Returns: 1 and the event in e, or 0 if the queue is empty.
+*/
+uint8_t joystick_event(joy_event *e);
+
+/*
+    Adds an event from another interrupt handler, such as a button's.
+  Interrupt handlers do not interrupt each other, so the queue still only
+  has one writer at a time.  Do not call it from the loop.
+*/
+void joystick_push_event(uint8_t type);
+
+/*
+  Returns: the number of events dropped because the queue was full.
+*/
+uint16_t joystick_dropped();
 
 #endif
@@ -8,6 +8,11 @@
 #include <SD.h>
 
 #include "lcd_image.h"
+#include "fixmath.h"
+
+// Within a block positions are stepped in 8 fractional bits, so they fit
+// in 16 bits relative to the patch
+#define ROTATE_SHIFT 8
 
 /* Draws the referenced image to the LCD screen.
  *
@@ -63,3 +68,181 @@ void lcd_image_draw(lcd_image_t *img, Adafruit_ST7735 *tft,
   file.close();
 }
 
+void lcd_image_draw_scaled(lcd_image_t *img, Adafruit_ST7735 *tft,
+			   uint16_t icol, uint16_t irow,
+			   uint16_t scol, uint16_t srow,
+			   uint16_t width, uint16_t height, uint8_t scale)
+{
+  File file;
+
+  // Open requested file on SD card if not already open
+  if ((file = SD.open(img->file_name)) == NULL) {
+    Serial.print("File not found:'");
+    Serial.print(img->file_name);
+    Serial.println('\'');
+    return;
+  }
+
+  uint16_t iwidth = width / scale;
+  uint16_t iheight = height / scale;
+
+  // Setup display to receive window of pixels
+  tft->setAddrWindow(scol, srow, scol+width-1, srow+height-1);
+
+  for (uint16_t row=0; row < iheight; row++) {
+    uint16_t pixels[iwidth];
+
+    // Seek to start of pixels to read from, need 32 bit arith for big images
+    uint32_t pos = ( (uint32_t) irow +  (uint32_t) row) *
+      (2 *  (uint32_t) img->ncols) +  (uint32_t) icol * 2;
+    file.seek(pos);
+
+    // Read row of pixels
+    if (file.read((uint8_t *) pixels, 2 * iwidth) != 2 * iwidth) {
+      Serial.println("SD Card Read Error!");
+      file.close();
+      return;
+    }
+
+    // pixel bytes in reverse order on card
+    for (uint16_t col=0; col < iwidth; col++) {
+      pixels[col] = (pixels[col] << 8) | (pixels[col] >> 8);
+    }
+
+    // Send each row scale times, each pixel scale times over
+    for (uint8_t rep=0; rep < scale; rep++) {
+      for (uint16_t col=0; col < iwidth; col++) {
+        for (uint8_t i=0; i < scale; i++) {
+          tft->pushColor(pixels[col]);
+        }
+      }
+    }
+  }
+
+  file.close();
+}
+
+
+void lcd_image_draw_rotated(lcd_image_t *img, Adafruit_ST7735 *tft,
+			    int32_t icol, int32_t irow,
+			    int16_t pcol, int16_t prow,
+			    uint16_t scol, uint16_t srow,
+			    uint16_t width, uint16_t height,
+			    int16_t angle, uint16_t background)
+{
+  File file;
+
+  // Open requested file on SD card if not already open
+  if ((file = SD.open(img->file_name)) == NULL) {
+    Serial.print("File not found:'");
+    Serial.print(img->file_name);
+    Serial.println('\'');
+    return;
+  }
+
+  // One screen pixel across moves (c, s) on the image, one down (-s, c)
+  int16_t c = (fix_cos((int32_t) angle * FIX_DEG)
+               + (1 << (FIX_SHIFT - ROTATE_SHIFT - 1)))
+    >> (FIX_SHIFT - ROTATE_SHIFT);
+  int16_t s = (fix_sin((int32_t) angle * FIX_DEG)
+               + (1 << (FIX_SHIFT - ROTATE_SHIFT - 1)))
+    >> (FIX_SHIFT - ROTATE_SHIFT);
+
+  uint16_t patch[ROTATE_PATCH][ROTATE_PATCH];
+
+  // 32 bit bounds, so a rectangle running past 65535 still ends
+  int32_t bottom = (int32_t) srow + height;
+  int32_t right = (int32_t) scol + width;
+
+  for (int32_t by=srow; by < bottom; by += ROTATE_BLOCK) {
+    uint16_t bh = min((int32_t) ROTATE_BLOCK, bottom-by);
+
+    for (int32_t bx=scol; bx < right; bx += ROTATE_BLOCK) {
+      uint16_t bw = min((int32_t) ROTATE_BLOCK, right-bx);
+
+      // Image position of the block's top-left pixel from the pivot, plus
+      // a half so truncating picks the nearest pixel
+      int32_t u = (int32_t) bx - pcol;
+      int32_t v = (int32_t) by - prow;
+      int32_t x0 = u * c - v * s + (1 << (ROTATE_SHIFT - 1));
+      int32_t y0 = u * s + v * c + (1 << (ROTATE_SHIFT - 1));
+
+      // The turned block's corners bound the patch to read
+      int32_t across_x = (int32_t) (bw - 1) * c;
+      int32_t across_y = (int32_t) (bw - 1) * s;
+      int32_t down_x = -(int32_t) (bh - 1) * s;
+      int32_t down_y = (int32_t) (bh - 1) * c;
+      int32_t x_min = x0 + min(across_x, 0) + min(down_x, 0);
+      int32_t x_max = x0 + max(across_x, 0) + max(down_x, 0);
+      int32_t y_min = y0 + min(across_y, 0) + min(down_y, 0);
+      int32_t y_max = y0 + max(across_y, 0) + max(down_y, 0);
+
+      int32_t pcol0 = x_min >> ROTATE_SHIFT;
+      int32_t prow0 = y_min >> ROTATE_SHIFT;
+      uint8_t pwidth = (x_max >> ROTATE_SHIFT) - pcol0 + 1;
+      uint8_t pheight = (y_max >> ROTATE_SHIFT) - prow0 + 1;
+
+      // Read the patch a row at a time, only the part on the image
+      int32_t col = icol + pcol0;
+      int32_t first = max(col, 0);
+      int32_t last = min(col + pwidth, (int32_t) img->ncols);
+
+      for (uint8_t row=0; row < pheight; row++) {
+        uint16_t *pixels = patch[row];
+        int32_t irow_at = irow + prow0 + row;
+
+        if (irow_at < 0 || irow_at >= img->nrows || first >= last) {
+          for (uint8_t i=0; i < pwidth; i++) {
+            pixels[i] = background;
+          }
+          continue;
+        }
+
+        for (int32_t i=col; i < first; i++) {
+          pixels[i - col] = background;
+        }
+        for (int32_t i=last; i < col + pwidth; i++) {
+          pixels[i - col] = background;
+        }
+
+        // Seek to start of pixels to read from, need 32 bit arith for big
+        // images
+        uint32_t pos = ( (uint32_t) irow_at * (uint32_t) img->ncols
+                         + (uint32_t) first ) * 2;
+        file.seek(pos);
+
+        uint16_t count = last - first;
+        uint16_t *dest = pixels + (first - col);
+        if (file.read((uint8_t *) dest, 2 * count) != 2 * count) {
+          Serial.println("SD Card Read Error!");
+          file.close();
+          return;
+        }
+
+        // pixel bytes in reverse order on card
+        for (uint16_t i=0; i < count; i++) {
+          dest[i] = (dest[i] << 8) | (dest[i] >> 8);
+        }
+      }
+
+      // Walk the block over the patch
+      tft->setAddrWindow(bx, by, bx+bw-1, by+bh-1);
+
+      int16_t row_x = x0 - pcol0 * (1 << ROTATE_SHIFT);
+      int16_t row_y = y0 - prow0 * (1 << ROTATE_SHIFT);
+      for (uint8_t j=0; j < bh; j++) {
+        int16_t x = row_x;
+        int16_t y = row_y;
+        for (uint8_t i=0; i < bw; i++) {
+          tft->pushColor(patch[y >> ROTATE_SHIFT][x >> ROTATE_SHIFT]);
+          x += c;
+          y += s;
+        }
+        row_x -= s;
+        row_y += c;
+      }
+    }
+  }
+
+  file.close();
+}
@@ -35,4 +35,56 @@ void lcd_image_draw(lcd_image_t *img, Adafruit_ST7735 *tft,
 		    uint16_t scol, uint16_t srow, 
 		    uint16_t width, uint16_t height);
 
+/* Draws the referenced image to the LCD screen blown up by a whole
+ * factor, each pixel repeated scale times across and down.  Only
+ * width/scale by height/scale pixels are read from the card, so it is a
+ * quick stand-in for a more detailed image.
+ *
+ * img           : the image to draw
+ * tft           : the initialized tft struct
+ * icol, irow    : the upper-left corner of the image patch to draw
+ * scol, srow    : the upper-left corner of the screen to draw to
+ * width, height : the size drawn on the screen, multiples of scale
+ * scale         : how many screen pixels each image pixel covers
+ */
+void lcd_image_draw_scaled(lcd_image_t *img, Adafruit_ST7735 *tft,
+			   uint16_t icol, uint16_t irow,
+			   uint16_t scol, uint16_t srow,
+			   uint16_t width, uint16_t height, uint8_t scale);
+
+// lcd_image_draw_rotated() works through the screen in blocks this big.  A
+// block turned by any angle spans at most 16 * sqrt(2) image pixels, so
+// the patch under it always fits in ROTATE_PATCH square.  The patch is
+// kept on the stack, so anything that hands out the free memory has to
+// leave LCD_IMAGE_ROTATE_STACK bytes of it.
+#define ROTATE_BLOCK 16
+#define ROTATE_PATCH 24
+#define LCD_IMAGE_ROTATE_STACK (ROTATE_PATCH * ROTATE_PATCH * sizeof(uint16_t))
+
+/* Draws part of the screen from the referenced image turned by an angle
+ * about a pivot, picking the nearest image pixel for each screen pixel.
+ * Turning by angle clockwise brings what lies in that direction from the
+ * pivot to straight above it on the screen.  Screen pixels that fall off
+ * the image are filled with the background.
+ *
+ * The screen is drawn in 16x16 blocks.  For each block only the patch of
+ * the image it covers, at most 24x24 pixels, is read from the card, so
+ * the memory used does not depend on the angle or the size drawn.
+ *
+ * img           : the image to draw
+ * tft           : the initialized tft struct
+ * icol, irow    : the image pixel at the pivot
+ * pcol, prow    : the screen pixel at the pivot
+ * scol, srow    : the upper-left corner of the screen to draw to
+ * width, height : the size drawn on the screen
+ * angle         : the turn in degrees, clockwise
+ * background    : the color off the image
+ */
+void lcd_image_draw_rotated(lcd_image_t *img, Adafruit_ST7735 *tft,
+			    int32_t icol, int32_t irow,
+			    int16_t pcol, int16_t prow,
+			    uint16_t scol, uint16_t srow,
+			    uint16_t width, uint16_t height,
+			    int16_t angle, uint16_t background);
+
 #endif
@@ -0,0 +1,200 @@
+#include <Arduino.h>
+
+#include "magcal.h"
+
+// forgetting applied once per batch: (1 - 1/1024)^MAGCAL_BATCH, so the fit
+// remembers about the last 1000 samples, half a minute at 30 Hz
+const float magcal_decay = 0.9692;
+
+// weight of the pull towards the starting offsets, in samples
+const float magcal_prior = 64;
+
+// weight needed before the first fit is tried
+const float magcal_min_weight = 256;
+
+// an axis needs this much spread (standard deviation), as a fraction of the
+// radius, to be fit.  Near Edmonton the horizontal field is only a quarter
+// of the total, so turning round on level ground gives about 0.17.
+const float magcal_min_spread = 0.1;
+
+// accepted range of the fitted radius, in calibrated units
+const float magcal_min_radius = 50;
+const float magcal_max_radius = 2000;
+
+int16_t magcal_radius = 0;
+
+// Samples are taken relative to the starting offsets, ref, and scaled as
+// the heading code scales them.  The unknowns are q = (2 c, r^2 - |c|^2)
+// with c also relative to ref, so the pull towards the start is towards 0.
+static int16_t ref[3];
+static int16_t scale[3];
+static int16_t offset[3];
+
+// sums of [u 1] [u 1]^T, upper triangle, and of |u|^2 [u 1]
+static float sum_uu[4][4];
+static float sum_bu[4];
+static uint8_t batch;
+
+void magcal_begin(const lsm303_calibration *cal) {
+    for (uint8_t i = 0; i < 3; i++) {
+        ref[i] = offset[i] = cal->offset[i];
+        scale[i] = cal->scale[i];
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t j = 0; j < 4; j++) {
+            sum_uu[i][j] = 0;
+        }
+        sum_bu[i] = 0;
+    }
+    batch = 0;
+    magcal_radius = 0;
+}
+
+void magcal_offsets(int16_t out[3]) {
+    for (uint8_t i = 0; i < 3; i++) {
+        out[i] = offset[i];
+    }
+}
+
+// Solves the 4x4 system a x = b in place by Gaussian elimination with
+// partial pivoting.  Returns 0 if it is singular.
+static uint8_t solve4(float a[4][4], float b[4], float x[4]) {
+    for (uint8_t col = 0; col < 4; col++) {
+        uint8_t pivot = col;
+        for (uint8_t r = col + 1; r < 4; r++) {
+            if (fabs(a[r][col]) > fabs(a[pivot][col])) {
+                pivot = r;
+            }
+        }
+        if (a[pivot][col] == 0) {
+            return 0;
+        }
+        if (pivot != col) {
+            for (uint8_t c = 0; c < 4; c++) {
+                float t = a[col][c]; a[col][c] = a[pivot][c]; a[pivot][c] = t;
+            }
+            float t = b[col]; b[col] = b[pivot]; b[pivot] = t;
+        }
+        for (uint8_t r = col + 1; r < 4; r++) {
+            float f = a[r][col] / a[col][col];
+            for (uint8_t c = col; c < 4; c++) {
+                a[r][c] -= f * a[col][c];
+            }
+            b[r] -= f * b[col];
+        }
+    }
+    for (int8_t r = 3; r >= 0; r--) {
+        float s = b[r];
+        for (uint8_t c = r + 1; c < 4; c++) {
+            s -= a[r][c] * x[c];
+        }
+        x[r] = s / a[r][r];
+    }
+    return 1;
+}
+
+// Fits a sphere to the sums.  Returns 1 and updates the offsets if the fit
+// is plausible.
+static uint8_t magcal_fit() {
+    float n = sum_uu[3][3];
+    if (n < magcal_min_weight) {
+        return 0;
+    }
+
+    // the pull towards the start is scaled to the spread of the samples,
+    // so it is worth magcal_prior samples whatever the field strength
+    float var[3];
+    float mean_var = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        float mean = sum_uu[i][3] / n;
+        var[i] = sum_uu[i][i] / n - mean * mean;
+        mean_var += var[i] / 3;
+    }
+
+    float a[4][4];
+    float b[4];
+    float q[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t j = i; j < 4; j++) {
+            a[i][j] = a[j][i] = sum_uu[i][j];
+        }
+        b[i] = sum_bu[i];
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        a[i][i] += magcal_prior * mean_var;
+    }
+    if (!solve4(a, b, q)) {
+        return 0;
+    }
+
+    float c[3];
+    float r2 = q[3];
+    for (uint8_t i = 0; i < 3; i++) {
+        c[i] = q[i] / 2;
+        r2 += c[i] * c[i];
+    }
+    if (r2 < magcal_min_radius * magcal_min_radius ||
+        r2 > magcal_max_radius * magcal_max_radius) {
+        return 0;
+    }
+
+    // Turning about one axis leaves the other two with spread, anything
+    // less is not worth a fit.
+    float min_var = magcal_min_spread * magcal_min_spread * r2;
+    uint8_t spread_axes = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        if (var[i] >= min_var) {
+            spread_axes++;
+        }
+    }
+    if (spread_axes < 2) {
+        return 0;
+    }
+
+    // back to raw units.  An axis without the spread keeps its offset, as
+    // the little it moves there is the noise on that axis.
+    uint8_t changed = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        if (var[i] < min_var) {
+            continue;
+        }
+        int16_t o = ref[i] + (int16_t) lround(c[i] * LSM303_CAL_ONE / scale[i]);
+        if (o != offset[i]) {
+            offset[i] = o;
+            changed = 1;
+        }
+    }
+    magcal_radius = sqrt(r2);
+    return changed;
+}
+
+uint8_t magcal_add(int16_t x, int16_t y, int16_t z) {
+    float u[4];
+    u[0] = (float) (x - ref[0]) * scale[0] / LSM303_CAL_ONE;
+    u[1] = (float) (y - ref[1]) * scale[1] / LSM303_CAL_ONE;
+    u[2] = (float) (z - ref[2]) * scale[2] / LSM303_CAL_ONE;
+    u[3] = 1;
+    float b = u[0]*u[0] + u[1]*u[1] + u[2]*u[2];
+
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t j = i; j < 4; j++) {
+            sum_uu[i][j] += u[i] * u[j];
+        }
+        sum_bu[i] += b * u[i];
+    }
+
+    if (++batch < MAGCAL_BATCH) {
+        return 0;
+    }
+    batch = 0;
+
+    uint8_t changed = magcal_fit();
+
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t j = i; j < 4; j++) {
+            sum_uu[i][j] *= magcal_decay;
+        }
+        sum_bu[i] *= magcal_decay;
+    }
+    return changed;
+}
@@ -0,0 +1,48 @@
+/*
+ Background hard iron calibration of the magnetometer.
+
+ Every compass sample is added to running sums for a least squares sphere
+ fit, |m - c|^2 = r^2, which is linear in c and r^2 - |c|^2.  The sums are
+ a fixed 4x4 system however many samples there are, and old samples are
+ slowly forgotten, so the estimate follows the magnetic environment of
+ whatever the device is carried in.  The system is only solved every
+ MAGCAL_BATCH samples.
+
+ Turning about one axis, as when walking, only pins down the offsets
+ across that axis.  The fit is pulled towards the offsets it started from,
+ so an axis without enough spread keeps its old offset instead of
+ wandering off.
+ */
+
+#ifndef MAGCAL_H
+#define MAGCAL_H
+
+#include <stdint.h>
+#include "LSM303.h"
+
+// samples between fits
+#define MAGCAL_BATCH 32
+
+/*
+    Starts the estimator from a calibration, normally the one the compass
+  loaded from EEPROM.  The scales are kept as they are; only the offsets
+  are estimated.
+*/
+void magcal_begin(const lsm303_calibration *cal);
+
+/*
+    Adds a raw magnetometer sample.
+
+  Returns: 1 if a fit was accepted and the offsets have changed, 0 if not.
+*/
+uint8_t magcal_add(int16_t x, int16_t y, int16_t z);
+
+/*
+    Copies the current offset estimate into offset[3].
+*/
+void magcal_offsets(int16_t offset[3]);
+
+// radius of the last accepted fit, in calibrated units, 0 if none yet
+extern int16_t magcal_radius;
+
+#endif
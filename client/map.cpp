@@ -8,6 +8,9 @@
 #include "GTPA010.h"
 #include "ledon.h"
 #include "path.h"
+#include "predict.h"
+#include "fixmath.h"
+#include "profile.h"
 // #define DEBUG
 
 /*
@@ -63,6 +66,26 @@ uint16_t gps_map_x;
 int32_t gps_lon = 0;
 int32_t gps_lat = 0;
 
+// set once the dot is on the screen, cleared when the map is redrawn
+uint8_t gps_drawn = 0;
+
+// After a zoom the map is drawn from the new tile in bands of this many
+// rows, one per call to draw_map_refine().  map_refine_row is the next row
+// to draw, display_window_height once the map on screen is complete.
+const uint16_t map_refine_band = 16;
+uint16_t map_refine_row = display_window_height;
+
+// Heading-up mode: the map is turned about the centre of the window so
+// the compass heading points up.  The map turns in map_rotate_step degree
+// steps, and only once the heading is map_rotate_slack degrees past the
+// middle between two steps, so a heading wavering on the boundary does
+// not keep redrawing it.  Off the map is filled with map_background.
+uint8_t map_heading_up = 0;
+int16_t map_rotation = 0;
+const uint8_t map_rotate_step = 15;
+const uint8_t map_rotate_slack = 3;
+const uint16_t map_background = BLACK;
+
 const uint8_t num_maps = 6;
 
 /* 
@@ -154,11 +177,12 @@ int32_t latitude_to_y(char map_num, int32_t map_latitude) {
                  0, map_y_limit[map_num]);
 }
 
-// zoom in and out routines that are used in interrupt handlers to
-// change the shared version of the map_num.  In order to maintain consistent
-// updates, the shared value should only be sampled at well-defined points.
+// zoom in and out routines that change the requested map_num as zoom
+// button events are taken off the joystick queue.  In order to maintain
+// consistent updates, the request is only applied, by set_zoom(), at
+// well-defined points.
 
-volatile uint8_t shared_new_map_num = 2;
+uint8_t shared_new_map_num = 2;
 
 void initialize_map() {
     cursor_lon = 0;
@@ -205,9 +229,71 @@ uint8_t set_zoom() {
     }
         
 
+/*
+    Draws part of the screen from the current map turned to map_rotation,
+    about the centre of the window.  The part is clipped to the window, so
+    it may start off the top or left.
+*/
+static void draw_map_rotated(int16_t scol, int16_t srow,
+                             int16_t width, int16_t height) {
+    if (scol < 0) {
+        width += scol;
+        scol = 0;
+    }
+    if (srow < 0) {
+        height += srow;
+        srow = 0;
+    }
+    width = min(width, (int16_t) display_window_width - scol);
+    height = min(height, (int16_t) display_window_height - srow);
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    lcd_image_draw_rotated(&map_tiles[current_map_num], &tft,
+                           screen_map_x + display_window_width / 2,
+                           screen_map_y + display_window_height / 2,
+                           display_window_width / 2,
+                           display_window_height / 2,
+                           scol, srow, width, height,
+                           map_rotation, map_background);
+}
+
+void map_to_screen(int32_t map_x, int32_t map_y, int16_t *x, int16_t *y) {
+    int32_t dx = map_x - screen_map_x;
+    int32_t dy = map_y - screen_map_y;
+
+    if (map_heading_up) {
+        // turn back the other way about the centre of the window
+        int32_t c = fix_cos((int32_t) map_rotation * FIX_DEG);
+        int32_t s = fix_sin((int32_t) map_rotation * FIX_DEG);
+        dx -= display_window_width / 2;
+        dy -= display_window_height / 2;
+        int32_t u = (dx * c + dy * s + FIX_ONE / 2) >> FIX_SHIFT;
+        int32_t v = (dy * c - dx * s + FIX_ONE / 2) >> FIX_SHIFT;
+        dx = u + display_window_width / 2;
+        dy = v + display_window_height / 2;
+    }
+
+    *x = dx;
+    *y = dy;
+}
+
+uint8_t turn_map(int16_t heading) {
+    // how far the heading is from the map, -180 to 179 degrees
+    int16_t off = ((heading - map_rotation) % 360 + 540) % 360 - 180;
+    if (abs(off) <= map_rotate_step / 2 + map_rotate_slack) {
+        return 0;
+    }
+
+    heading = (heading % 360 + 360) % 360;
+    map_rotation = (heading + map_rotate_step / 2) / map_rotate_step
+        * map_rotate_step % 360;
+    return 1;
+}
+
 void draw_compass() {
-  compass.read();
-  int compass_dir = compass.heading() + 90;
+  int compass_dir = compass.heading() - map_rotation + 90;
 
   // Avoid updating 
   if (abs(compass_dir - compass_old) < 5 && compass_drawn == 1)
@@ -243,35 +329,43 @@ void draw_compass() {
  */
 void draw_gps_dot() {
     
-    //Get the GPS data
-    gpsData* gdata;
-    GTPA010::readData();
-    gdata = GTPA010::getData();
-
-    // Erase old dot if position changed
-    if ((gdata->lat != gps_lat || gdata->lon != gps_lon) && is_gps_visible()) {
-        erase_gps();
+    // Get the position, carried on from the last fix by the predictor so
+    // the dot moves smoothly between fixes
+    int32_t lat, lon;
+    if (!predict_position(millis(), &lat, &lon)) {
+        gpsData* gdata = GTPA010::getData();
+        lat = gdata->lat;
+        lon = gdata->lon;
     }
 
-    if (gdata->lat != gps_lat || gdata->lon != gps_lon) {
-        coord_t * dest = get_prev_destination();
+    //Take the lat, lon, map to pixels
+    uint16_t map_x = longitude_to_x(current_map_num, lon);
+    uint16_t map_y = latitude_to_y(current_map_num, lat);
+
+    gps_lat = lat;
+    gps_lon = lon;
+
+    // Only touch the screen when the dot moves by a pixel
+    if (gps_drawn && map_x == gps_map_x && map_y == gps_map_y)
+        return;
+
+    // Erase old dot
+    if (gps_drawn && is_gps_visible()) {
+        erase_gps();
     }
 
-    gps_lat = gdata->lat;
-    gps_lon = gdata->lon;
-    
-    //Take the lat, lon, map to pixels
-    gps_map_x = longitude_to_x(current_map_num, gps_lon);
-    gps_map_y = latitude_to_y(current_map_num, gps_lat);
+    gps_map_x = map_x;
+    gps_map_y = map_y;
 
 #ifdef DEBUG_GPS
     GTPA010::printData();
 #endif
 
-    if (is_gps_visible())
-        tft.fillCircle(gps_map_x - screen_map_x,
-                       gps_map_y - screen_map_y, dot_radius, BLUE);
-
+    uint16_t gps_screen_x;
+    uint16_t gps_screen_y;
+    if (get_gps_screen_x_y(&gps_screen_x, &gps_screen_y))
+        tft.fillCircle(gps_screen_x, gps_screen_y, dot_radius, BLUE);
+    gps_drawn = 1;
 }
 
 
@@ -288,22 +382,83 @@ void draw_map_screen() {
         tft.println("DRAWING...");
     #endif
 
-    lcd_image_draw(&map_tiles[current_map_num], &tft,
-                    screen_map_x, screen_map_y,
-                    0, 0, 128, 160);
+    if (map_heading_up) {
+        PROFILE_BEGIN(DRAW_ROTATED);
+        draw_map_rotated(0, 0, display_window_width, display_window_height);
+        PROFILE_END(DRAW_ROTATED);
+    } else {
+        lcd_image_draw(&map_tiles[current_map_num], &tft,
+                        screen_map_x, screen_map_y,
+                        0, 0, 128, 160);
+    }
 
     compass_drawn = 0;
+    gps_drawn = 0;
+    map_refine_row = display_window_height;
     
 }
 
-uint8_t is_gps_visible() {
-    uint8_t r = 
-        screen_map_x < gps_map_x &&
-        gps_map_x < screen_map_x + display_window_width &&
-        screen_map_y < gps_map_y &&
-        gps_map_y < screen_map_y + display_window_height; 
+void draw_map_preview(uint8_t old_map_num) {
+    uint16_t w = display_window_width;
+    uint16_t h = display_window_height;
+
+    if (map_heading_up) {
+        // There is no quick stand-in for a turned map, the bands just come
+        // in over the old one
+    } else if (current_map_num > old_map_num) {
+        // Zoomed in: the new window is a small part of the old map, so read
+        // just that and blow it up
+        uint8_t scale = 1 << (current_map_num - old_map_num);
+        int32_t old_x = longitude_to_x(old_map_num,
+            x_to_longitude(current_map_num, screen_map_x));
+        int32_t old_y = latitude_to_y(old_map_num,
+            y_to_latitude(current_map_num, screen_map_y));
+        old_x = constrain(old_x, 0, map_x_limit[old_map_num] + 1 - w / scale);
+        old_y = constrain(old_y, 0, map_y_limit[old_map_num] + 1 - h / scale);
+
+        lcd_image_draw_scaled(&map_tiles[old_map_num], &tft,
+                              old_x, old_y, 0, 0, w, h, scale);
+    } else {
+        // Zoomed out: the old window shrinks to the middle of the new one,
+        // where the user was looking, so draw that part from the new map
+        // first.  It is a quarter of the reading of the whole window.
+        lcd_image_draw(&map_tiles[current_map_num], &tft,
+                       screen_map_x + w / 4, screen_map_y + h / 4,
+                       w / 4, h / 4, w / 2, h / 2);
+    }
 
-    return r;
+    compass_drawn = 0;
+    gps_drawn = 0;
+    map_refine_row = 0;
+}
+
+uint8_t draw_map_refine() {
+    if (map_refine_row >= display_window_height) {
+        return 1;
+    }
+
+    uint16_t rows = display_window_height - map_refine_row;
+    if (rows > map_refine_band) {
+        rows = map_refine_band;
+    }
+    if (map_heading_up) {
+        PROFILE_BEGIN(DRAW_ROTATED);
+        draw_map_rotated(0, map_refine_row, display_window_width, rows);
+        PROFILE_END(DRAW_ROTATED);
+    } else {
+        lcd_image_draw(&map_tiles[current_map_num], &tft,
+                       screen_map_x, screen_map_y + map_refine_row,
+                       0, map_refine_row, display_window_width, rows);
+    }
+    map_refine_row += rows;
+
+    return map_refine_row >= display_window_height;
+}
+
+uint8_t is_gps_visible() {
+    uint16_t gps_screen_x;
+    uint16_t gps_screen_y;
+    return get_gps_screen_x_y(&gps_screen_x, &gps_screen_y);
     }
 
 uint8_t is_cursor_visible() {
@@ -332,9 +487,13 @@ uint8_t is_cursor_visible() {
 
 uint8_t get_gps_screen_x_y(
     uint16_t *gps_screen_x,uint16_t *gps_screen_y) {
-    if ( is_gps_visible ) {
-        *gps_screen_x = gps_map_x - display_window_width;
-        *gps_screen_y = gps_map_y - display_window_height;
+    int16_t x;
+    int16_t y;
+    map_to_screen(gps_map_x, gps_map_y, &x, &y);
+    if ( 0 < x && x < display_window_width &&
+         0 < y && y < display_window_height ) {
+        *gps_screen_x = x;
+        *gps_screen_y = y;
         return 1;
         }
 
@@ -345,8 +504,11 @@ uint8_t get_gps_screen_x_y(
 uint8_t get_cursor_screen_x_y(
     uint16_t *cursor_screen_x,uint16_t *cursor_screen_y) {
     if ( is_cursor_visible ) {
-        *cursor_screen_x = cursor_map_x - screen_map_x;
-        *cursor_screen_y = cursor_map_y - screen_map_y;
+        int16_t x;
+        int16_t y;
+        map_to_screen(cursor_map_x, cursor_map_y, &x, &y);
+        *cursor_screen_x = x;
+        *cursor_screen_y = y;
         return 1;
         }
 
@@ -359,24 +521,33 @@ void draw_cursor() {
     uint16_t cursor_screen_x;
     uint16_t cursor_screen_y;
     if ( get_cursor_screen_x_y(&cursor_screen_x, &cursor_screen_y) ) {
-        cursor_screen_x = cursor_map_x - screen_map_x;
-        cursor_screen_y = cursor_map_y - screen_map_y;
         tft.fillCircle(cursor_screen_x, cursor_screen_y, dot_radius, RED);
         }
     }
 
+// Redraw the map on top of a dot at the given map and screen position
+static void erase_dot(uint16_t map_x, uint16_t map_y,
+                      uint16_t screen_x, uint16_t screen_y) {
+    if (map_heading_up) {
+        draw_map_rotated((int16_t) screen_x - dot_radius,
+                         (int16_t) screen_y - dot_radius,
+                         2 * dot_radius + 1, 2 * dot_radius + 1);
+    } else {
+        lcd_image_draw(&map_tiles[current_map_num], &tft,
+            map_x - dot_radius,
+            map_y - dot_radius,
+            screen_x - dot_radius,
+            screen_y - dot_radius,
+            2 * dot_radius + 1,
+            2 * dot_radius + 1);
+    }
+}
+
 void erase_gps() {
     uint16_t gps_screen_x;
     uint16_t gps_screen_y;
     if ( get_gps_screen_x_y(&gps_screen_x, &gps_screen_y) ) {
-        // Redraw the map on top of the current cursor position
-        lcd_image_draw(&map_tiles[current_map_num], &tft,
-            gps_map_x - dot_radius,
-            gps_map_y - dot_radius,
-            gps_screen_x - dot_radius,
-            gps_screen_y - dot_radius,
-            2 * dot_radius + 1,
-            2 * dot_radius + 1);
+        erase_dot(gps_map_x, gps_map_y, gps_screen_x, gps_screen_y);
         }
     }
 
@@ -384,21 +555,116 @@ void erase_cursor() {
     uint16_t cursor_screen_x;
     uint16_t cursor_screen_y;
     if ( get_cursor_screen_x_y(&cursor_screen_x, &cursor_screen_y) ) {
-        // Redraw the map on top of the current cursor position
-        lcd_image_draw(&map_tiles[current_map_num], &tft,
-            cursor_map_x - dot_radius,
-            cursor_map_y - dot_radius,
-            cursor_screen_x - dot_radius,
-            cursor_screen_y - dot_radius,
-            2 * dot_radius + 1,
-            2 * dot_radius + 1);
+        erase_dot(cursor_map_x, cursor_map_y,
+                  cursor_screen_x, cursor_screen_y);
         }
     }
 
 void move_to_gps() {
-    gpsData * gData = GTPA010::getData();
-    move_window(gData->lon - display_window_width/2,
-                gData->lat - display_window_height/2);
+    // centre the window on the dot, as last drawn
+    move_window_to(longitude_to_x(current_map_num, gps_lon)
+                       - display_window_width / 2,
+                   latitude_to_y(current_map_num, gps_lat)
+                       - display_window_height / 2);
+}
+
+/*
+    GPS follow mode.  The window stays put while the dot is inside the
+    middle of the screen, more than follow_margin_x/y pixels from the
+    edges.  When it leaves, the window moves just far enough to put the
+    dot on the opposite side of that zone, so walking in a straight line
+    gets the longest run before the next move.  The screen cannot be read
+    back or scrolled, so every move is a full redraw; a token bucket
+    allows follow_budget of them a minute, and jittery fixes just wait.
+    Turning a heading-up map is a full redraw as well, so follow_turn()
+    takes its turns from the same bucket.
+
+    A heading-up map turns about the centre of the window, so there the
+    window is centred on the dot again once it is follow_radius pixels
+    from the centre, and the map keeps turning about the user.
+*/
+const int16_t follow_margin_x = 32;
+const int16_t follow_margin_y = 40;
+const int16_t follow_radius = 24;
+const uint8_t follow_budget = FOLLOW_BUDGET;
+const uint32_t follow_refill_ms = 60000 / follow_budget;
+
+uint8_t follow_tokens = follow_budget;
+uint32_t follow_refill_time = 0;
+
+// a token back every follow_refill_ms, up to a minute's worth
+static void follow_refill() {
+    uint32_t now = millis();
+    while (now - follow_refill_time >= follow_refill_ms) {
+        follow_refill_time += follow_refill_ms;
+        if (follow_tokens < follow_budget) {
+            follow_tokens++;
+        }
+    }
+}
+
+uint8_t follow_gps() {
+    follow_refill();
+
+    int32_t x = longitude_to_x(current_map_num, gps_lon) - screen_map_x;
+    int32_t y = latitude_to_y(current_map_num, gps_lat) - screen_map_y;
+
+    int32_t dx = 0;
+    int32_t dy = 0;
+    if (map_heading_up) {
+        int32_t cx = x - display_window_width / 2;
+        int32_t cy = y - display_window_height / 2;
+        if (cx * cx + cy * cy > (int32_t) follow_radius * follow_radius) {
+            dx = cx;
+            dy = cy;
+        }
+    } else {
+        if (x < follow_margin_x) {
+            dx = x - (display_window_width - follow_margin_x);
+        } else if (x > display_window_width - follow_margin_x) {
+            dx = x - follow_margin_x;
+        }
+        if (y < follow_margin_y) {
+            dy = y - (display_window_height - follow_margin_y);
+        } else if (y > display_window_height - follow_margin_y) {
+            dy = y - follow_margin_y;
+        }
+    }
+
+    if ((dx == 0 && dy == 0) || follow_tokens == 0) {
+        return 0;
+    }
+    follow_tokens--;
+
+    uint16_t old_x = screen_map_x;
+    uint16_t old_y = screen_map_y;
+    move_window_to(screen_map_x + dx, screen_map_y + dy);
+
+    // at the edge of the map the window may not move at all
+    return screen_map_x != old_x || screen_map_y != old_y;
+}
+
+uint8_t follow_turn(int16_t heading) {
+    follow_refill();
+    if (follow_tokens == 0 || !turn_map(heading)) {
+        return 0;
+    }
+    follow_tokens--;
+    return 1;
+}
+
+uint16_t follow_run() {
+    if (map_heading_up) {
+        return follow_radius;
+    }
+    return min(display_window_width - 2 * follow_margin_x,
+               display_window_height - 2 * follow_margin_y);
+}
+
+void start_follow_gps() {
+    follow_tokens = follow_budget;
+    follow_refill_time = millis();
+    move_to_gps();
 }
 
 void move_window(int32_t lon, int32_t lat) {
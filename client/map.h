@@ -67,6 +67,43 @@ uint8_t is_gps_visible();
 
 void initialize_map();
 void draw_map_screen();
+
+/*
+    Zoom transition.  Right after set_zoom(), draw_map_preview() puts up a
+  stand-in for the new map window at once: after zooming in, the part of
+  the old map it covers blown up; after zooming out, the middle of the new
+  map, where the old window was.  Each call to draw_map_refine() then
+  draws the next band of rows of the new map over it.
+
+  draw_map_refine() returns: 1 once the map on screen is complete.
+*/
+void draw_map_preview(uint8_t old_map_num);
+uint8_t draw_map_refine();
+
+/*
+    Heading-up mode.  While map_heading_up is set the map is drawn turned
+  by map_rotation degrees about the centre of the window, so the heading
+  points up, and the overlays are placed with map_to_screen().  A turned
+  map reads several times as much of the card as a plain one, so it is
+  best drawn through draw_map_preview() and draw_map_refine().
+
+  turn_map() brings map_rotation to the nearest step of the heading, with
+  some slack so it does not flip between two steps.
+
+  turn_map() returns: 1 if map_rotation changed and the map has to be
+    redrawn.
+*/
+extern uint8_t map_heading_up;
+extern int16_t map_rotation;
+uint8_t turn_map(int16_t heading);
+
+/*
+    Converts a position on the current map to a position on the screen,
+  turned with the map in heading-up mode.  It may be off the screen.
+*/
+void map_to_screen(int32_t map_x, int32_t map_y, int16_t *x, int16_t *y);
+
+uint8_t get_gps_screen_x_y(uint16_t *gps_screen_x,uint16_t *gps_screen_y);
 uint8_t get_cursor_screen_x_y(uint16_t *cursor_screen_x,uint16_t *cursor_screen_y);
 void draw_cursor();
 void erase_cursor();
@@ -77,10 +114,42 @@ void erase_gps();
 void draw_compass();
 void draw_gps_dot();
 void move_window_to(int16_t x, int16_t y);
+
+/*
+    GPS follow mode.  start_follow_gps() centres the window on the GPS dot
+  and resets the redraw budget.  follow_gps() is then called after each
+  draw_gps_dot(), and moves the window when the dot has left the middle
+  of the screen, within a budget of FOLLOW_BUDGET redraws a minute.
+
+  follow_gps() returns: 1 if the window moved and the map has to be
+    redrawn.
+*/
+#define FOLLOW_BUDGET 6
+
+void start_follow_gps();
+uint8_t follow_gps();
+
+/*
+    Turns a heading-up map with the heading while following the dot, like
+  turn_map(), but each turn is taken from follow_gps()'s budget, and the
+  map is left as it is while the budget is used up.
+
+  follow_turn() returns: 1 if the map turned and has to be redrawn.
+*/
+uint8_t follow_turn(int16_t heading);
+
+/*
+  Returns: how far, in pixels, the dot travels in a straight line between
+    two moves of the window in follow mode, at the least.
+*/
+uint16_t follow_run();
+
+// centres the window on the GPS dot
+void move_to_gps();
 void move_window(int32_t lon, int32_t lat);
 void move_cursor_to(int16_t x, int16_t y);
 void move_cursor_by(int16_t dx, int16_t dy);
 
-extern volatile uint8_t shared_new_map_num;
+extern uint8_t shared_new_map_num;
 
 #endif
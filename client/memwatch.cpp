@@ -0,0 +1,76 @@
+#include "memwatch.h"
+
+#ifdef DEBUG_MEMORY
+
+#include <Arduino.h>
+#include <mem_syms.h>
+
+// stack frames rarely hold this value, so a run of it is untouched memory
+#define MEMWATCH_PAINT 0xC5
+
+// the end of the static data, from the linker
+extern char __heap_start;
+
+// the highest the heap end has been
+static char *heap_peak = 0;
+
+// the lowest address the stack is known to have written
+static char *stack_low = STACK_BOTTOM;
+
+// Paints everything from the end of the static data up to the stack.  It
+// runs from .init3, after the stack pointer and the zero register are set
+// up and before the static data is copied, so it has no frame of its own.
+void memwatch_paint() __attribute__((naked, used, section(".init3")));
+void memwatch_paint() {
+    char *p = &__heap_start;
+    while (p < STACK_TOP) {
+        *p++ = MEMWATCH_PAINT;
+    }
+}
+
+void memwatch_heap() {
+    char *end = HEAP_END;
+    if (end > heap_peak) {
+        heap_peak = end;
+    }
+}
+
+void memwatch_poll() {
+    memwatch_heap();
+
+    // the heap has overwritten the paint below its peak, and everything
+    // from the old mark up is known to be used, so only the gap between
+    // them needs looking at
+    char *p = heap_peak;
+    while (p < stack_low && *p == MEMWATCH_PAINT) {
+        p++;
+    }
+    // if the heap peak has run past the stack mark, keep the mark; the
+    // mark only ever moves down
+    if (p < stack_low) {
+        stack_low = p;
+    }
+}
+
+uint16_t memwatch_stack_peak() {
+    return STACK_BOTTOM - stack_low + 1;
+}
+
+uint16_t memwatch_heap_peak() {
+    return heap_peak - HEAP_START;
+}
+
+uint16_t memwatch_min_free() {
+    return stack_low - heap_peak;
+}
+
+void memwatch_report() {
+    Serial.print("mem stack peak ");
+    Serial.print(memwatch_stack_peak());
+    Serial.print(" heap peak ");
+    Serial.print(memwatch_heap_peak());
+    Serial.print(" min free ");
+    Serial.println(memwatch_min_free());
+}
+
+#endif
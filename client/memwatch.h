@@ -0,0 +1,67 @@
+/*
+ Stack and heap high water marks, built on mem_syms.h.
+
+ Before main() runs, the free memory between the end of the static data
+ and the stack is painted with a known byte.  The stack only ever leaves
+ other values behind, so scanning up from the top of the heap for the
+ first byte that is not paint finds the deepest the stack has been.  The
+ heap end is sampled as well, on every poll and right after the path is
+ allocated, to keep its peak.
+
+ Define DEBUG_MEMORY to turn it on.  Without it the calls are empty.
+ */
+
+#ifndef MEMWATCH_H
+#define MEMWATCH_H
+
+#include <stdint.h>
+
+// #define DEBUG_MEMORY
+
+// how often the client prints the marks, in ms
+#define MEMWATCH_REPORT_MS 10000
+
+#ifdef DEBUG_MEMORY
+
+/*
+    Samples the heap end and rescans the stack paint.  The scan only
+  covers the bytes between the heap peak and the old stack mark, a few
+  cycles each.
+*/
+void memwatch_poll();
+
+/*
+    Samples the heap end only.  Call it right after big allocations.
+*/
+void memwatch_heap();
+
+/*
+  Returns: the most stack used since startup, in bytes, as of the last
+    poll.
+*/
+uint16_t memwatch_stack_peak();
+
+/*
+  Returns: the largest the heap has been, in bytes.
+*/
+uint16_t memwatch_heap_peak();
+
+/*
+  Returns: the least free memory there has been between the heap and the
+    stack, in bytes.
+*/
+uint16_t memwatch_min_free();
+
+/*
+    Prints the marks on Serial.
+*/
+void memwatch_report();
+
+#else
+
+#define memwatch_poll()
+#define memwatch_heap()
+
+#endif
+
+#endif
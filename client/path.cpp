@@ -5,18 +5,29 @@
 #include <math.h>
 
 #include "map.h"
+#include "lcd_image.h"
 #include "serial_handling.h"
 #include "ledon.h"
 #include "LSM303.h"
+#include "fixmath.h"
+#include "memwatch.h"
 
 // #define DEBUG_PATH
 
 /* path routine error code
    0 no error
-   1 
+   1 path length out of range
+   2 could not allocate the path
+   3 malformed or out of range number from the server
+   4 no reply from the server
 */
 int16_t path_errno;
 
+// how long to wait for the server to find a path, and then for each
+// character of the reply, in ms
+const uint16_t path_reply_timeout = 10000;
+const uint16_t path_char_timeout = 1000;
+
 int16_t target_dir = 0;
 int8_t has_path = 0;
 
@@ -33,15 +44,7 @@ coord_t ** last_path_p = 0;
 // Returns 1 if the call was successful, 0 if not.
 
 uint8_t read_path(uint16_t *length_p, coord_t *path_p[]) {
-    // the line to be read, and it size
-    const uint8_t line_size = 40;
-    char line[line_size];
-    uint16_t bytes_read;
-
     // the field extracted
-    const uint8_t field_size = 20;
-    char field[field_size];
-    uint16_t field_index;
     int32_t field_value;
 
     *length_p = 0;
@@ -50,22 +53,23 @@ uint8_t read_path(uint16_t *length_p, coord_t *path_p[]) {
     // reset the error code
     path_errno = 0;
 
-    while ( ! Serial.available() )  { };
-
-    uint16_t max_path_size = (AVAIL_MEM - 256) / sizeof(coord_t);
+    // the path stays on the heap while heading-up draws the map, so leave
+    // room for the rotated draw's patch as well as the usual stack
+    uint16_t max_path_size = (AVAIL_MEM - 256 - LCD_IMAGE_ROTATE_STACK)
+        / sizeof(coord_t);
 
     #ifdef DEBUG_PATH
         Serial.print("Max path length ");
         Serial.println(max_path_size);
     #endif
 
-    bytes_read = serial_readline(line, line_size);
-
-    // read the number of points, first field
-    field_index = 0;   
-    field_index = 
-        string_read_field(line, field_index, field, field_size, " ");
-    field_value = string_get_int(field);
+    // read the number of points, first field, giving the server time to
+    // find the path
+    uint8_t status = serial_read_int(&field_value, path_reply_timeout);
+    if ( status != SERIAL_INT_OK ) {
+        path_errno = status == SERIAL_INT_TIMEOUT ? 4 : 3;
+        return 0;
+        }
 
     #ifdef DEBUG_PATH
         Serial.print("Path length ");
@@ -78,8 +82,7 @@ uint8_t read_path(uint16_t *length_p, coord_t *path_p[]) {
         path_errno = 1;
         return 0;
         }
-    uint8_t tmp_length = field_value;
-    *length_p = tmp_length;
+    uint16_t tmp_length = field_value;
 
     // allocate the storage, see if we got it.
     coord_t *tmp_path = (coord_t *) malloc( tmp_length * sizeof(coord_t));
@@ -89,21 +92,26 @@ uint8_t read_path(uint16_t *length_p, coord_t *path_p[]) {
         return 0; 
         }
 
+    // the path is the biggest thing on the heap, catch the peak now
+    memwatch_heap();
+
+    *length_p = tmp_length;
     *path_p = tmp_path;
 
     while ( tmp_length > 0 ) {
-        bytes_read = serial_readline(line, line_size);
-
-        // read the number of points, first field
-        field_index = 0;   
-
-        field_index = 
-            string_read_field(line, field_index, field, field_size, " ");
-        tmp_path->lat = string_get_int(field);
-
-        field_index = 
-            string_read_field(line, field_index, field, field_size, " ");
-        tmp_path->lon = string_get_int(field);
+        // each point is a lat lon pair, parsed straight off the serial port
+        status = serial_read_int(&tmp_path->lat, path_char_timeout);
+        if ( status == SERIAL_INT_OK ) {
+            status = serial_read_int(&tmp_path->lon, path_char_timeout);
+            }
+        if ( status != SERIAL_INT_OK ) {
+            free(*path_p);
+            *path_p = 0;
+            *length_p = 0;
+            path_errno = status == SERIAL_INT_TIMEOUT ? 4 : 3;
+            has_path = 0;
+            return 0;
+            }
 
         tmp_length--;
         tmp_path++;
@@ -141,6 +149,56 @@ uint8_t is_coord_visible(coord_t point) {
     return r;
     }
 
+void path_update_target(int32_t lat, int32_t lon) {
+    if (!last_path_len || *last_path_len < 2)
+        return;
+
+    // the path starts where the request was made, so the second point is
+    // the next one to walk to
+    coord_t next = (*last_path_p)[1];
+    if (next.lat == lat && next.lon == lon)
+        return;
+
+    target_dir = (fix_atan2(next.lon - lon, next.lat - lat) / FIX_DEG
+                  - 180) % 360;
+}
+
+// the path turns where its direction changes by more than this, in degrees
+const int16_t path_turn_angle = 30;
+
+uint8_t path_next_turn(coord_t *turn) {
+    if (!last_path_len || *last_path_len < 2)
+        return 0;
+
+    coord_t *p = *last_path_p;
+    uint16_t n = *last_path_len;
+
+    // the path starts where the request was made, so the walk to the
+    // second point is already under way and the first bend can be there
+    int16_t dir = fix_atan2(p[1].lon - p[0].lon, p[1].lat - p[0].lat);
+    for (uint16_t i = 1; i < n - 1; i++) {
+        if (p[i+1].lat == p[i].lat && p[i+1].lon == p[i].lon)
+            continue;
+
+        int16_t next_dir = fix_atan2(p[i+1].lon - p[i].lon,
+                                     p[i+1].lat - p[i].lat);
+        int16_t bend = next_dir - dir;
+        if (bend > 180 * FIX_DEG)
+            bend -= 360 * FIX_DEG;
+        else if (bend < -180 * FIX_DEG)
+            bend += 360 * FIX_DEG;
+
+        if (abs(bend) > path_turn_angle * FIX_DEG) {
+            *turn = p[i];
+            return 1;
+        }
+        dir = next_dir;
+    }
+
+    *turn = p[n-1];
+    return 1;
+}
+
 coord_t * get_prev_destination() {
     if (!last_path_len || !*last_path_len)
         return 0;
@@ -158,14 +216,13 @@ void draw_path(uint16_t length, coord_t path[]) {
         Serial.println("Drawing line");
 #endif
         
-        int16_t startx = longitude_to_x(current_map_num, path[i].lon)
-            - screen_map_x;
-        int16_t starty = latitude_to_y(current_map_num, path[i].lat)
-            - screen_map_y;
-        int16_t endx = longitude_to_x(current_map_num, path[i+1].lon)
-            - screen_map_x;
-        int16_t endy = latitude_to_y(current_map_num, path[i+1].lat)
-            - screen_map_y;
+        int16_t startx, starty, endx, endy;
+        map_to_screen(longitude_to_x(current_map_num, path[i].lon),
+                      latitude_to_y(current_map_num, path[i].lat),
+                      &startx, &starty);
+        map_to_screen(longitude_to_x(current_map_num, path[i+1].lon),
+                      latitude_to_y(current_map_num, path[i+1].lat),
+                      &endx, &endy);
         
         tft.drawLine(startx, starty, endx, endy, BLUE);
     }
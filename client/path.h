@@ -8,6 +8,13 @@ extern int8_t has_path;
 uint8_t read_path(uint16_t *length_p, coord_t *path_p[]);
 void draw_path(uint16_t length, coord_t path[]);
 coord_t * get_prev_destination();
+
+// point target_dir from the given position to the next point on the path
+void path_update_target(int32_t lat, int32_t lon);
+
+// the next point after the one being walked to where the path turns, or
+// its end; returns 0 if there is no path
+uint8_t path_next_turn(coord_t *turn);
 uint8_t is_coord_visible(coord_t point);
 
 #endif
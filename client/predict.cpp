@@ -0,0 +1,145 @@
+#include <Arduino.h>
+
+#include "predict.h"
+#include "fixmath.h"
+#include "TinyGPS.h"
+
+// filter gains, in 256ths: alpha for the position, beta for the velocity
+// from the position error, gamma for the velocity reported by the GPS
+const int32_t predict_alpha = 224;
+const int32_t predict_beta = 64;
+const int32_t predict_gamma = 128;
+
+// below this speed, in 100ths of a knot, the GPS course is mostly noise
+// and the compass gives the direction instead
+const uint32_t predict_course_speed = 200;
+
+// below this speed the GPS is taken to be standing still
+const uint32_t predict_still_speed = 30;
+
+// how far the position may get from the origin before it is moved, in
+// map units (about 4 km)
+const int32_t predict_max_offset = 4096;
+
+// 1e-5 degrees of latitude per second for 1/100 knot is 0.004621; this is
+// that << 18, giving 1/256 map units per second when the Q14 sine or cosine
+// of the course is folded in
+const int32_t knots_to_lat = 1211;
+
+static uint8_t primed = 0;
+static int32_t origin_lat, origin_lon;
+static int32_t pos_lat, pos_lon;    // relative to origin, 1/256 map units
+static int32_t vel_lat, vel_lon;    // 1/256 map units per second
+static uint32_t fix_time;
+static int32_t fix_lat, fix_lon;    // the last fix, as given
+static uint8_t speed_seen = 0;      // a valid GPS speed since the reset
+static int32_t knots_to_lon;        // knots_to_lat / cos(latitude)
+
+// Moves the origin to the given fix and clears the state.
+static void predict_reset(int32_t lat, int32_t lon, uint32_t time) {
+    origin_lat = lat;
+    origin_lon = lon;
+    pos_lat = pos_lon = 0;
+    vel_lat = vel_lon = 0;
+    fix_time = time;
+    speed_seen = 0;
+
+    // a degree of longitude shrinks with the cosine of the latitude
+    int16_t cos_lat = fix_cos((int32_t) (lat / 100000) * FIX_DEG);
+    if (cos_lat < FIX_ONE / 16) {
+        cos_lat = FIX_ONE / 16;
+    }
+    knots_to_lon = knots_to_lat * FIX_ONE / cos_lat;
+    primed = 1;
+}
+
+// Position at time, relative to the origin.
+static void predict_at(uint32_t time, int32_t *lat, int32_t *lon) {
+    int32_t age = time - fix_time;
+    if (age > PREDICT_MAX_AGE) {
+        age = PREDICT_MAX_AGE;
+    }
+    *lat = pos_lat + vel_lat * age / 1000;
+    *lon = pos_lon + vel_lon * age / 1000;
+}
+
+void predict_fix(int32_t lat, int32_t lon, uint32_t time,
+        uint32_t speed, uint32_t course, int16_t heading) {
+    fix_lat = lat;
+    fix_lon = lon;
+    if (!primed || time - fix_time > PREDICT_RESET_AGE ||
+        abs(lat - origin_lat) > predict_max_offset ||
+        abs(lon - origin_lon) > predict_max_offset) {
+        int32_t keep_lat = vel_lat, keep_lon = vel_lon;
+        uint8_t keep_seen = speed_seen;
+        uint8_t moving = primed && time - fix_time <= PREDICT_RESET_AGE;
+        predict_reset(lat, lon, time);
+        if (moving) {
+            // only the origin moved, the velocity still holds
+            vel_lat = keep_lat;
+            vel_lon = keep_lon;
+            speed_seen = keep_seen;
+        }
+        return;
+    }
+
+    int32_t dt = time - fix_time;
+    if (dt <= 0) {
+        return;
+    }
+
+    // correct the prediction by a fraction of its error
+    int32_t pred_lat, pred_lon;
+    predict_at(time, &pred_lat, &pred_lon);
+    int32_t err_lat = (lat - origin_lat) * 256 - pred_lat;
+    int32_t err_lon = (lon - origin_lon) * 256 - pred_lon;
+
+    pos_lat = pred_lat + (err_lat * predict_alpha >> 8);
+    pos_lon = pred_lon + (err_lon * predict_alpha >> 8);
+    vel_lat += (err_lat * predict_beta >> 8) * 1000 / dt;
+    vel_lon += (err_lon * predict_beta >> 8) * 1000 / dt;
+    fix_time = time;
+
+    // then pull the velocity towards the one the GPS measured
+    if (speed != TinyGPS::GPS_INVALID_SPEED) {
+        speed_seen = 1;
+        int32_t meas_lat = 0, meas_lon = 0;
+        if (speed >= predict_still_speed) {
+            int32_t dir;
+            if (speed >= predict_course_speed &&
+                course != TinyGPS::GPS_INVALID_ANGLE) {
+                dir = (int32_t) course * FIX_DEG / 100;
+            } else {
+                dir = (int32_t) heading * FIX_DEG;
+            }
+            meas_lat = ((int32_t) speed * fix_cos(dir) >> FIX_SHIFT)
+                * knots_to_lat >> 10;
+            meas_lon = ((int32_t) speed * fix_sin(dir) >> FIX_SHIFT)
+                * knots_to_lon >> 10;
+        }
+        vel_lat += (meas_lat - vel_lat) * predict_gamma >> 8;
+        vel_lon += (meas_lon - vel_lon) * predict_gamma >> 8;
+    }
+}
+
+uint8_t predict_position(uint32_t time, int32_t *lat, int32_t *lon) {
+    if (!primed) {
+        return 0;
+    }
+
+    // The velocity learned from the fixes alone follows the noise in them,
+    // so nothing is extrapolated until the GPS has reported a speed.
+    if (!speed_seen) {
+        *lat = fix_lat;
+        *lon = fix_lon;
+        return 1;
+    }
+
+    int32_t rel_lat, rel_lon;
+    predict_at(time, &rel_lat, &rel_lon);
+
+    // round to the nearest map unit
+    *lat = origin_lat + ((rel_lat + 128) >> 8);
+    *lon = origin_lon + ((rel_lon + 128) >> 8);
+    return 1;
+}
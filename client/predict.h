@@ -0,0 +1,51 @@
+/*
+ Position predictor for the GPS dot and the glasses.
+
+ Fixes arrive once a second at best, so between them the position is
+ extrapolated by an alpha-beta filter: each fix corrects the predicted
+ position and velocity by fixed fractions of the error.  When the GPS
+ reports a ground speed, that speed along the course (or along the compass
+ heading at walking speeds, where the course is mostly noise) is blended
+ into the velocity as well.
+
+ Everything is integer.  Positions are kept relative to an origin near the
+ first fix, in 1/256ths of the 1e-5 degree units used by the map.
+ */
+
+#ifndef PREDICT_H
+#define PREDICT_H
+
+#include <stdint.h>
+
+// don't extrapolate further than this past the last fix, in ms
+#define PREDICT_MAX_AGE 3000
+
+// a gap between fixes longer than this restarts the filter, in ms
+#define PREDICT_RESET_AGE 5000
+
+/*
+    Feeds a GPS fix to the predictor.
+
+  Arguments:
+  lat, lon: The fix, in 1e-5 degrees.
+  time: millis() when the fix was decoded.
+  speed: Ground speed from TinyGPS, in 100ths of a knot, or
+    TinyGPS::GPS_INVALID_SPEED.
+  course: Course over ground from TinyGPS, in 100ths of a degree, or
+    TinyGPS::GPS_INVALID_ANGLE.
+  heading: Compass heading in degrees, used for the direction of travel
+    when the course is not reliable.
+*/
+void predict_fix(int32_t lat, int32_t lon, uint32_t time,
+    uint32_t speed, uint32_t course, int16_t heading);
+
+/*
+    Estimates the position at the given time.
+
+  Returns: 1 and the position in lat and lon, in 1e-5 degrees, or 0 if
+    there has been no fix yet.  Until a fix has come with a valid speed the
+    position is the last fix, not extrapolated.
+*/
+uint8_t predict_position(uint32_t time, int32_t *lat, int32_t *lon);
+
+#endif
@@ -0,0 +1,107 @@
+#include "profile.h"
+
+#ifdef PROFILE
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdio.h>
+#include <time.h>
+#endif
+
+// in the order of prof_stage
+static const char *stage_names[PROF_NUM_STAGES] = {
+    "joystick",
+    "compass",
+    "gps",
+    "draw_compass",
+    "draw_gps_dot",
+    "refresh_display",
+    "query_path",
+    "draw_rotated"
+};
+
+typedef struct {
+    uint16_t count;
+    uint32_t total;
+    uint32_t min;
+    uint32_t max;
+} prof_entry;
+
+static prof_entry table[PROF_NUM_STAGES];
+
+#ifdef ARDUINO
+static uint32_t last_report = 0;
+#endif
+
+uint32_t profile_now() {
+#ifdef ARDUINO
+    return micros();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+void profile_record(uint8_t stage, uint32_t us) {
+    prof_entry *e = &table[stage];
+
+    // a full count would make the average meaningless, so start over
+    if (e->count == 0xFFFF) {
+        e->count = 0;
+    }
+    if (e->count == 0 || us < e->min) {
+        e->min = us;
+    }
+    if (e->count == 0 || us > e->max) {
+        e->max = us;
+    }
+    if (e->count == 0) {
+        e->total = 0;
+    }
+    e->total += us;
+    e->count++;
+}
+
+void profile_report() {
+    for (uint8_t i = 0; i < PROF_NUM_STAGES; i++) {
+        prof_entry *e = &table[i];
+        if (e->count == 0) {
+            continue;
+        }
+#ifdef ARDUINO
+        Serial.print("prof ");
+        Serial.print(stage_names[i]);
+        Serial.print(" n ");
+        Serial.print(e->count);
+        Serial.print(" min ");
+        Serial.print(e->min);
+        Serial.print(" avg ");
+        Serial.print(e->total / e->count);
+        Serial.print(" max ");
+        Serial.println(e->max);
+#else
+        printf("prof %s n %u min %lu avg %lu max %lu\n", stage_names[i],
+               e->count, (unsigned long) e->min,
+               (unsigned long) (e->total / e->count),
+               (unsigned long) e->max);
+#endif
+        e->count = 0;
+    }
+}
+
+void profile_poll() {
+#ifdef ARDUINO
+    uint8_t asked = Serial.available() && Serial.peek() == PROFILE_COMMAND;
+    if (asked) {
+        Serial.read();
+    }
+    if (asked || millis() - last_report >= PROFILE_REPORT_MS) {
+        last_report = millis();
+        profile_report();
+    }
+#endif
+}
+
+#endif
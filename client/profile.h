@@ -0,0 +1,75 @@
+/*
+ Stage timing for the main loop.
+
+ Wrap a stage in PROFILE_BEGIN(stage) and PROFILE_END(stage), where stage
+ is one of the prof_stage names without the PROF_ prefix, and each run
+ adds its time in microseconds to a static table of call counts and
+ min/avg/max times.  profile_report() prints the table.
+
+ Define PROFILE to turn it on.  Without it the macros are empty and the
+ table is not built, so the stages cost nothing.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+// #define PROFILE
+
+// how often the client prints the table when profiling, in ms
+#define PROFILE_REPORT_MS 10000
+
+// a byte from the serial port that asks for the table straight away
+#define PROFILE_COMMAND 'P'
+
+// the stages, add the name to profile.cpp as well
+enum prof_stage {
+    PROF_JOYSTICK,
+    PROF_COMPASS,
+    PROF_GPS,
+    PROF_DRAW_COMPASS,
+    PROF_DRAW_GPS_DOT,
+    PROF_REFRESH,
+    PROF_QUERY_PATH,
+    PROF_DRAW_ROTATED,
+    PROF_NUM_STAGES
+};
+
+#ifdef PROFILE
+
+#define PROFILE_BEGIN(stage) uint32_t prof_start_##stage = profile_now()
+#define PROFILE_END(stage) \
+    profile_record(PROF_##stage, profile_now() - prof_start_##stage)
+
+/*
+    The time in microseconds: micros() on the Arduino, the monotonic clock
+  on a host.
+*/
+uint32_t profile_now();
+
+/*
+    Adds one run of a stage to the table.
+*/
+void profile_record(uint8_t stage, uint32_t us);
+
+/*
+    Prints the count and min/avg/max times of every stage that ran on
+  Serial, and starts the table over.
+*/
+void profile_report();
+
+/*
+    Prints the table if it was asked for over the serial port, or if
+  PROFILE_REPORT_MS has passed since it was last printed.
+*/
+void profile_poll();
+
+#else
+
+#define PROFILE_BEGIN(stage)
+#define PROFILE_END(stage)
+
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#include <Arduino.h>
+
+#include "sched.h"
+
+typedef struct {
+    const char *name;
+    void (*run)();
+    uint16_t period_ms;
+    uint16_t budget_us;
+    uint32_t deadline;      // millis() when it is next due
+    uint16_t runs;
+    uint16_t overruns;      // runs that took longer than the budget
+    uint16_t late;          // periods missed altogether
+    uint32_t worst_us;      // a display redraw can take well over 65 ms
+} sched_task;
+
+static sched_task tasks[SCHED_MAX_TASKS];
+static uint8_t num_tasks = 0;
+
+int8_t sched_add(const char *name, void (*run)(), uint16_t period_ms,
+        uint16_t budget_us) {
+    if (num_tasks >= SCHED_MAX_TASKS) {
+        return -1;
+    }
+    sched_task *t = &tasks[num_tasks];
+    t->name = name;
+    t->run = run;
+    t->period_ms = period_ms;
+    t->budget_us = budget_us;
+    t->deadline = millis();
+    t->runs = t->overruns = t->late = t->worst_us = 0;
+    return num_tasks++;
+}
+
+// Runs one task and moves its deadline on by a period.
+static void sched_run_task(sched_task *t) {
+    uint32_t start = micros();
+    t->run();
+    uint32_t took = micros() - start;
+
+    t->runs++;
+    if (took > t->budget_us) {
+        t->overruns++;
+    }
+    if (took > t->worst_us) {
+        t->worst_us = took;
+    }
+
+    // keep to the period, unless a whole one was missed, then skip ahead
+    // instead of running back to back to catch up
+    t->deadline += t->period_ms;
+    uint32_t now = millis();
+    if ((int32_t) (now - t->deadline) >= (int32_t) t->period_ms) {
+        if (t->period_ms > 0) {
+            t->late++;
+        }
+        t->deadline = now + t->period_ms;
+    }
+}
+
+void sched_run() {
+    // each due task runs once per pass, most overdue first
+    uint8_t done[SCHED_MAX_TASKS] = { 0 };
+
+    while (1) {
+        uint32_t now = millis();
+        sched_task *next = 0;
+        int32_t most_overdue = -1;
+        for (uint8_t i = 0; i < num_tasks; i++) {
+            int32_t overdue = now - tasks[i].deadline;
+            if (!done[i] && overdue > most_overdue) {
+                most_overdue = overdue;
+                next = &tasks[i];
+            }
+        }
+        if (!next) {
+            return;
+        }
+        done[next - tasks] = 1;
+        sched_run_task(next);
+    }
+}
+
+void sched_report() {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        sched_task *t = &tasks[i];
+        Serial.print(t->name);
+        Serial.print(": ");
+        Serial.print(t->runs);
+        Serial.print(" runs, ");
+        Serial.print(t->overruns);
+        Serial.print(" over ");
+        Serial.print(t->budget_us);
+        Serial.print(" us, ");
+        Serial.print(t->late);
+        Serial.print(" late, worst ");
+        Serial.print(t->worst_us);
+        Serial.println(" us");
+        t->runs = t->overruns = t->late = t->worst_us = 0;
+    }
+}
@@ -0,0 +1,46 @@
+/*
+ A small cooperative scheduler for the main loop.
+
+ Each subsystem registers a task with a period and a time budget, and
+ loop() calls sched_run(), which runs the tasks that are due, earliest
+ deadline first.  Tasks are never preempted, so a task that runs over its
+ budget delays the others; that is counted as an overrun, and a task that
+ misses a whole period is counted late and skips ahead rather than
+ running several times in a row to catch up.
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+// the most tasks that can be registered
+#define SCHED_MAX_TASKS 10
+
+/*
+    Registers a task.  It first runs on the next call to sched_run().
+
+  Arguments:
+  name: For the report, kept as a pointer.
+  run: The task.
+  period_ms: How often to run it, 0 for every pass of the loop.
+  budget_us: How long one run should take at most.
+
+  Returns: the task number, or -1 if the table is full.
+*/
+int8_t sched_add(const char *name, void (*run)(), uint16_t period_ms,
+    uint16_t budget_us);
+
+/*
+    Runs every task that is due, earliest deadline first.  Call it from
+  loop().
+*/
+void sched_run();
+
+/*
+    Prints each task's run count, overruns, late starts and worst time
+  on Serial, and starts the counts over.
+*/
+void sched_report();
+
+#endif
@@ -84,3 +84,239 @@ int32_t string_get_int(const char *str) {
 
     return val;
 }
+
+// Wait up to timeout_ms for a character on the serial port, and return
+// it, or -1 if none came.
+static int16_t serial_getc(uint16_t timeout_ms) {
+    uint32_t start = millis();
+    while (Serial.available() == 0) {
+        if ( millis() - start >= timeout_ms ) {
+            return -1;
+        }
+    }
+    return Serial.read();
+}
+
+uint8_t serial_read_int(int32_t *value, uint16_t timeout_ms) {
+    int16_t c;
+
+    // Skip over any separators left from the previous field or line.
+    do {
+        c = serial_getc(timeout_ms);
+    } while ( c == ' ' || c == '\r' || c == '\n' );
+
+    uint8_t is_neg = 0;
+    if ( c == '-' || c == '+' ) {
+        is_neg = c == '-';
+        c = serial_getc(timeout_ms);
+    }
+
+    // The most negative int32_t has a magnitude one more than the most
+    // positive one.
+    uint32_t limit = is_neg ? 2147483648UL : 2147483647UL;
+    uint32_t mag = 0;
+    uint8_t digits = 0;
+    uint8_t overflow = 0;
+
+    while ( c >= '0' && c <= '9' ) {
+        uint8_t digit = c - '0';
+
+        // mag * 10 + digit > limit, rearranged so that nothing overflows
+        if ( mag > (limit - digit) / 10 ) {
+            overflow = 1;
+        } else {
+            mag = mag * 10 + digit;
+        }
+        digits++;
+        c = serial_getc(timeout_ms);
+    }
+
+    if ( c < 0 ) {
+        return SERIAL_INT_TIMEOUT;
+    }
+    if ( digits == 0 || overflow ) {
+        return SERIAL_INT_BAD;
+    }
+
+    *value = is_neg ? -(int32_t) (mag - 1) - 1 : (int32_t) mag;
+    return SERIAL_INT_OK;
+}
+
+// Rates proposed to the server, fastest first.
+static const uint32_t serial_rates[] = { 250000, 115200, 57600 };
+static const uint8_t num_serial_rates =
+    sizeof(serial_rates) / sizeof(serial_rates[0]);
+
+// How long to wait for each reply during the handshake.  The server gives
+// up on the sync after one second, so the retry delay has to be longer.
+static const uint16_t serial_reply_timeout = 500;
+static const uint16_t serial_retry_delay = 1200;
+
+// Input is thrown away before a request until the port has been quiet for
+// this long, in ms, or for serial_flush_limit at the most.
+static const uint16_t serial_flush_quiet = 20;
+static const uint16_t serial_flush_limit = 1000;
+
+// Index of the fastest rate still worth proposing.
+static uint8_t serial_first_rate = 0;
+static uint32_t serial_baud = SERIAL_BASE_BAUD;
+static uint8_t serial_errors = 0;
+static uint8_t serial_renegotiate = 1;
+
+// millis() when the last request went out
+static uint32_t serial_last_request = 0;
+
+// Set while the server may still be at a rate the client has left, or
+// still waiting for a sync that failed, until millis() reaches
+// serial_wait_until.  Requests go out at SERIAL_BASE_BAUD until then.
+static uint8_t serial_wait_out = 0;
+static uint32_t serial_wait_until = 0;
+
+// Read a line like serial_readline(), but give up after timeout_ms.
+// Returns 1 if a line equal to expect was read.
+static uint8_t serial_expect_line(const char *expect, uint16_t timeout_ms) {
+    char line[16];
+    uint8_t len = 0;
+    uint32_t start = millis();
+
+    while ( millis() - start < timeout_ms ) {
+        if ( Serial.available() == 0 ) {
+            continue;
+        }
+
+        char c = (char) Serial.read();
+        if ( c == '\r' || c == '\n' ) {
+            if ( len == 0 ) {
+                continue;    // leftover half of a CRLF
+            }
+            line[len] = '\0';
+            if ( strcmp(line, expect) == 0 ) {
+                return 1;
+            }
+            len = 0;         // not our reply, keep waiting
+        } else if ( len < sizeof(line) - 1 ) {
+            line[len++] = c;
+        }
+    }
+    return 0;
+}
+
+static void serial_set_baud(uint32_t baud) {
+    Serial.flush();    // let the last bytes out at the old rate
+    Serial.end();
+    Serial.begin(baud);
+    serial_baud = baud;
+}
+
+// Don't negotiate again until wait_ms after since.
+static void serial_wait(uint32_t since, uint32_t wait_ms) {
+    serial_renegotiate = 1;
+    serial_wait_out = 1;
+    serial_wait_until = since + wait_ms;
+}
+
+// Go back to the base rate, and negotiate again once the server is sure
+// to have done the same, its link timeout after the last request at the
+// old rate.
+static void serial_fall_back() {
+    serial_set_baud(SERIAL_BASE_BAUD);
+    serial_wait(serial_last_request, SERIAL_LINK_TIMEOUT + SERIAL_LINK_MARGIN);
+}
+
+uint32_t serial_negotiate_baud() {
+    char reply[16];
+
+    if ( serial_wait_out ) {
+        if ( (int32_t) (millis() - serial_wait_until) < 0 ) {
+            // The server may still be at the old rate, stay at the base
+            // rate until a later request.
+            return serial_baud;
+        }
+        serial_wait_out = 0;
+    }
+    serial_renegotiate = 0;
+
+    // A rate that is refused or fails the sync is not proposed again
+    for ( ; serial_first_rate < num_serial_rates; serial_first_rate++) {
+        uint32_t rate = serial_rates[serial_first_rate];
+
+        Serial.print("B ");
+        Serial.println(rate);
+
+        sprintf(reply, "A %lu", (unsigned long) rate);
+        if ( ! serial_expect_line(reply, serial_reply_timeout) ) {
+            // Refused or not understood, the server is still at the
+            // base rate.
+            continue;
+        }
+
+        serial_set_baud(rate);
+        Serial.println("S");
+        if ( serial_expect_line("S", serial_reply_timeout) ) {
+            serial_last_request = millis();
+            return serial_baud;
+        }
+
+        // The link does not work at this rate.  Go back, and try the next
+        // one on a later request, once the server has timed out of the
+        // sync and done the same.
+        serial_set_baud(SERIAL_BASE_BAUD);
+        serial_first_rate++;
+        serial_wait(millis(), serial_retry_delay);
+        break;
+    }
+
+    return serial_baud;
+}
+
+void serial_report_ok() {
+    // only a good exchange at the negotiated rate breaks a run of fallbacks
+    // from it
+    if ( serial_baud != SERIAL_BASE_BAUD ) {
+        serial_errors = 0;
+    }
+}
+
+void serial_report_error() {
+    if ( serial_baud == SERIAL_BASE_BAUD ) {
+        return;
+    }
+
+    serial_errors++;
+    if ( serial_errors >= SERIAL_MAX_ERRORS ) {
+        // Don't propose this rate, or anything faster, again.
+        while ( serial_first_rate < num_serial_rates &&
+                serial_rates[serial_first_rate] >= serial_baud ) {
+            serial_first_rate++;
+        }
+        serial_errors = 0;
+    }
+    serial_fall_back();
+}
+
+void serial_start_request() {
+    // the server drops the rate SERIAL_LINK_TIMEOUT after the last request,
+    // don't cut it fine
+    if ( serial_baud != SERIAL_BASE_BAUD &&
+         millis() - serial_last_request >=
+             SERIAL_LINK_TIMEOUT - SERIAL_LINK_MARGIN ) {
+        serial_fall_back();
+    }
+
+    if ( serial_renegotiate && serial_first_rate < num_serial_rates ) {
+        serial_negotiate_baud();
+    }
+
+    // throw away anything left over, such as a late reply
+    uint32_t start = millis();
+    uint32_t last = start;
+    while ( millis() - last < serial_flush_quiet &&
+            millis() - start < serial_flush_limit ) {
+        if ( Serial.available() ) {
+            Serial.read();
+            last = millis();
+        }
+    }
+
+    serial_last_request = millis();
+}
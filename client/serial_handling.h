@@ -3,6 +3,26 @@
 
 #include <stdint.h>
 
+// Every session with the server starts at this rate, and falls back to it.
+#define SERIAL_BASE_BAUD 9600
+
+// At a negotiated rate the server goes back to SERIAL_BASE_BAUD once it has
+// had no good request for SERIAL_LINK_TIMEOUT ms (LINK_TIMEOUT in the
+// server's baud.py).  The client stops using the rate SERIAL_LINK_MARGIN ms
+// before that, and after an error waits until SERIAL_LINK_MARGIN ms past it
+// before negotiating again, so neither end has to count errors to agree.
+#define SERIAL_LINK_TIMEOUT 10000
+#define SERIAL_LINK_MARGIN 2000
+
+// Number of fallbacks in a row from a negotiated rate before it is no
+// longer proposed.
+#define SERIAL_MAX_ERRORS 3
+
+// serial_read_int() results
+#define SERIAL_INT_BAD 0
+#define SERIAL_INT_OK 1
+#define SERIAL_INT_TIMEOUT 2
+
 /*
     Function to read a single line from the serial buffer up to a specified
   length (length includes the null termination character that must be
@@ -66,4 +86,74 @@ uint16_t string_read_field(const char *str, uint16_t str_start,
 
 int32_t string_get_int(const char *str);
 
+/*
+    Function to read a signed decimal integer directly from the serial port,
+  without first copying the line or the field into a buffer.  Leading spaces
+  and newline characters are skipped, then an optional '-' or '+' and the
+  digits are consumed.  The character that ends the number (normally a space
+  or a newline) is consumed as well.  This function blocks, but gives up
+  when no character arrives for timeout_ms.
+
+  Arguments:
+  value:  Pointer to where the parsed integer will be stored.
+  timeout_ms:  The longest wait for each character.
+
+  Preconditions:  None.
+
+  Postconditions: On success the integer is stored in value.  On failure the
+    rest of the number is still consumed so that the next call starts on the
+    following field, and value is left unchanged.
+
+  Returns: SERIAL_INT_OK if an integer was read, SERIAL_INT_BAD if there
+    were no digits or the value does not fit in an int32_t, or
+    SERIAL_INT_TIMEOUT if the server stopped sending.
+
+*/
+uint8_t serial_read_int(int32_t *value, uint16_t timeout_ms);
+
+/*
+    Function to negotiate a faster baud rate with the server.  The client
+  proposes each rate it supports, fastest first, with a "B <rate>" line at
+  the current rate.  The server answers "A <rate>" and both ends switch, then
+  the client sends "S" at the new rate and expects "S" back.  If there is no
+  acknowledgement, or the sync fails, both ends stay at or return to
+  SERIAL_BASE_BAUD and the next slower rate is tried.  A server that does not
+  know the handshake ignores the request, so the session stays at
+  SERIAL_BASE_BAUD.
+
+  Preconditions:  Serial has been started at SERIAL_BASE_BAUD.
+
+  This function does not wait for the server.  After a fallback nothing is
+  proposed until the server's link timeout has run out, and after a failed
+  sync the next rate is proposed only once the server has given up on the
+  sync.  Until then the session stays at SERIAL_BASE_BAUD, and a later call
+  from serial_start_request() negotiates.
+
+  Postconditions: Serial is running at the returned rate.  Rates that were
+    refused, failed the sync, or fell back SERIAL_MAX_ERRORS times in a row,
+    are not proposed again.
+
+  Returns: the baud rate in use.
+
+*/
+uint32_t serial_negotiate_baud();
+
+/*
+    Gets the link ready for a new request, right before it is sent.  A
+  negotiated rate that is close to lapsing on the server is dropped, a
+  faster rate is negotiated again if one is worth trying and the server is
+  ready for it, and anything left on the port, such as the end of a reply
+  that came too late, is thrown away.
+*/
+void serial_start_request();
+
+/*
+    Functions to report the outcome of an exchange with the server.  After
+  an error at a negotiated rate the client drops back to SERIAL_BASE_BAUD at
+  once; the server does the same when its link timeout runs out, and
+  serial_start_request() negotiates again once it has.
+*/
+void serial_report_ok();
+void serial_report_error();
+
 #endif
@@ -59,6 +59,55 @@ static volatile uint8_t twi_rxBufferIndex;
 
 static volatile uint8_t twi_error;
 
+// queued register reads, and the one in progress on the bus
+static twi_request* volatile twi_queue[TWI_QUEUE_LENGTH];
+static volatile uint8_t twi_queueHead;
+static volatile uint8_t twi_queueTail;
+static twi_request* volatile twi_asyncReq;
+static volatile uint8_t twi_blocking;		// a blocking caller still needs the buffer
+
+static void twi_startQueued(void);
+static void twi_finishQueued(void);
+
+/* 
+ * Function twi_claim
+ * Desc     waits until twi is ready and takes it for a blocking transfer.
+ *          Queued reads are started from the ISR, so the test and the
+ *          claim are done with interrupts off.
+ * Input    state: TWI_MRX or TWI_MTX
+ * Output   none
+ */
+static void twi_claim(uint8_t state)
+{
+  for(;;){
+    uint8_t sreg = SREG;
+    cli();
+    if(TWI_READY == twi_state){
+      twi_state = state;
+      twi_blocking = true;
+      SREG = sreg;
+      return;
+    }
+    SREG = sreg;
+  }
+}
+
+/* 
+ * Function twi_unclaim
+ * Desc     called by a blocking transfer once it has its results, lets
+ *          queued reads use the bus and the buffer again
+ * Input    none
+ * Output   none
+ */
+static void twi_unclaim(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  twi_blocking = false;
+  twi_startQueued();
+  SREG = sreg;
+}
+
 /* 
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -122,10 +171,7 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   }
 
   // wait until twi is ready, become master receiver
-  while(TWI_READY != twi_state){
-    continue;
-  }
-  twi_state = TWI_MRX;
+  twi_claim(TWI_MRX);
   twi_sendStop = sendStop;
   // reset error state (0xFF.. no error occured)
   twi_error = 0xFF;
@@ -170,6 +216,7 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length, uint8_t sen
   for(i = 0; i < length; ++i){
     data[i] = twi_masterBuffer[i];
   }
+  twi_unclaim();
 	
   return length;
 }
@@ -199,10 +246,7 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
   }
 
   // wait until twi is ready, become master transmitter
-  while(TWI_READY != twi_state){
-    continue;
-  }
-  twi_state = TWI_MTX;
+  twi_claim(TWI_MTX);
   twi_sendStop = sendStop;
   // reset error state (0xFF.. no error occured)
   twi_error = 0xFF;
@@ -244,13 +288,166 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
   }
   
   if (twi_error == 0xFF)
-    return 0;	// success
+    i = 0;	// success
   else if (twi_error == TW_MT_SLA_NACK)
-    return 2;	// error: address send, nack received
+    i = 2;	// error: address send, nack received
   else if (twi_error == TW_MT_DATA_NACK)
-    return 3;	// error: data send, nack received
+    i = 3;	// error: data send, nack received
   else
-    return 4;	// other twi error
+    i = 4;	// other twi error
+  twi_unclaim();
+
+  return i;
+}
+
+/* 
+ * Function twi_submitRead
+ * Desc     queues a register read and returns without waiting. The ISR
+ *          writes the register address, sends a repeated start and reads
+ *          into req->data, then sets req->status to TWI_REQ_DONE or
+ *          TWI_REQ_ERROR. Queued reads run in order, between blocking
+ *          transfers.
+ * Input    req: the read; address, reg, data and length must be set
+ * Output   0 .. queued
+ *          1 .. bad length
+ *          2 .. queue full, or req already queued
+ */
+uint8_t twi_submitRead(twi_request* req)
+{
+  uint8_t next;
+  uint8_t sreg;
+
+  if(0 == req->length || TWI_BUFFER_LENGTH < req->length){
+    return 1;
+  }
+  if(TWI_REQ_PENDING == req->status){
+    return 2;
+  }
+
+  sreg = SREG;
+  cli();
+  next = (twi_queueHead + 1) % TWI_QUEUE_LENGTH;
+  if(next == twi_queueTail){
+    SREG = sreg;
+    return 2;
+  }
+  req->status = TWI_REQ_PENDING;
+  twi_queue[twi_queueHead] = req;
+  twi_queueHead = next;
+  twi_startQueued();
+  SREG = sreg;
+
+  return 0;
+}
+
+/* 
+ * Function twi_cancelRead
+ * Desc     gives up on a queued read that has not finished, such as one
+ *          held up by a slave that keeps SCL low. A read still waiting is
+ *          taken out of the queue; the one on the bus is abandoned and the
+ *          TWI module is reset so the next read can start. req->status is
+ *          set to TWI_REQ_ERROR.
+ * Input    req: the read
+ * Output   none
+ */
+void twi_cancelRead(twi_request* req)
+{
+  uint8_t sreg;
+  uint8_t i, j;
+
+  sreg = SREG;
+  cli();
+  if(TWI_REQ_PENDING != req->status){
+    SREG = sreg;
+    return;
+  }
+  if(twi_asyncReq == req){
+    twi_asyncReq = 0;
+    // drop whatever the module was doing, then bring it back up
+    TWCR = 0;
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+    twi_state = TWI_READY;
+    twi_inRepStart = false;
+  }else{
+    // close the gap left in the queue
+    for(i = twi_queueTail; i != twi_queueHead; i = (i + 1) % TWI_QUEUE_LENGTH){
+      if(twi_queue[i] == req){
+        break;
+      }
+    }
+    if(i != twi_queueHead){
+      for(j = (i + 1) % TWI_QUEUE_LENGTH; j != twi_queueHead;
+          j = (j + 1) % TWI_QUEUE_LENGTH){
+        twi_queue[i] = twi_queue[j];
+        i = j;
+      }
+      twi_queueHead = i;
+    }
+  }
+  req->status = TWI_REQ_ERROR;
+  twi_startQueued();
+  SREG = sreg;
+}
+
+/* 
+ * Function twi_startQueued
+ * Desc     starts the next queued read if the bus is free. Called with
+ *          interrupts off, from twi_submitRead or at the end of a transfer.
+ *          A blocking transfer that ended with a repeated start still owns
+ *          the bus, so nothing is started until it sends its stop.
+ * Input    none
+ * Output   none
+ */
+static void twi_startQueued(void)
+{
+  twi_request* req;
+
+  if(TWI_READY != twi_state || twi_blocking || twi_inRepStart ||
+     twi_queueHead == twi_queueTail){
+    return;
+  }
+  req = twi_queue[twi_queueTail];
+  twi_queueTail = (twi_queueTail + 1) % TWI_QUEUE_LENGTH;
+  twi_asyncReq = req;
+
+  // write phase: just the register address, no stop
+  twi_state = TWI_MTX;
+  twi_sendStop = false;
+  twi_error = 0xFF;
+  twi_masterBuffer[0] = req->reg;
+  twi_masterBufferIndex = 0;
+  twi_masterBufferLength = 1;
+  twi_slarw = TW_WRITE | (req->address << 1);
+
+  TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
+}
+
+/* 
+ * Function twi_finishQueued
+ * Desc     completes the queued read on the bus, if any, when the
+ *          transfer ends
+ * Input    none
+ * Output   none
+ */
+static void twi_finishQueued(void)
+{
+  twi_request* req = twi_asyncReq;
+  uint8_t i;
+
+  if(!req){
+    return;
+  }
+  twi_asyncReq = 0;
+
+  if(TWI_MRX == twi_state && 0xFF == twi_error &&
+     twi_masterBufferIndex == req->length){
+    for(i = 0; i < req->length; ++i){
+      req->data[i] = twi_masterBuffer[i];
+    }
+    req->status = TWI_REQ_DONE;
+  }else{
+    req->status = TWI_REQ_ERROR;
+  }
 }
 
 /* 
@@ -342,7 +539,9 @@ void twi_stop(void)
   }
 
   // update twi state
+  twi_finishQueued();
   twi_state = TWI_READY;
+  twi_startQueued();
 }
 
 /* 
@@ -357,7 +556,9 @@ void twi_releaseBus(void)
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT);
 
   // update twi state
+  twi_finishQueued();
   twi_state = TWI_READY;
+  twi_startQueued();
 }
 
 SIGNAL(TWI_vect)
@@ -379,6 +580,14 @@ SIGNAL(TWI_vect)
         // copy data to output register and ack
         TWDR = twi_masterBuffer[twi_masterBufferIndex++];
         twi_reply(1);
+      }else if(twi_asyncReq){
+        // queued read: register address sent, turn around and read
+        twi_state = TWI_MRX;
+        twi_sendStop = true;
+        twi_masterBufferIndex = 0;
+        twi_masterBufferLength = twi_asyncReq->length - 1;
+        twi_slarw = TW_READ | (twi_asyncReq->address << 1);
+        TWCR = _BV(TWINT) | _BV(TWEA) | _BV(TWEN) | _BV(TWIE) | _BV(TWSTA);
       }else{
 	if (twi_sendStop)
           twi_stop();
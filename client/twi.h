@@ -37,6 +37,28 @@
   #define TWI_MTX   2
   #define TWI_SRX   3
   #define TWI_STX   4
+
+  // number of register reads that can wait for the bus
+  #ifndef TWI_QUEUE_LENGTH
+  #define TWI_QUEUE_LENGTH 4
+  #endif
+
+  // twi_request status
+  #define TWI_REQ_IDLE    0
+  #define TWI_REQ_PENDING 1
+  #define TWI_REQ_DONE    2
+  #define TWI_REQ_ERROR   3
+
+  // A register read run from the TWI interrupt: write reg, repeated start,
+  // read length bytes into data.  The caller owns the request and must not
+  // touch it while status is TWI_REQ_PENDING.
+  typedef struct {
+    uint8_t address;          // 7bit i2c device address
+    uint8_t reg;              // first register to read
+    uint8_t *data;
+    uint8_t length;
+    volatile uint8_t status;
+  } twi_request;
   
   void twi_init(void);
   void twi_setAddress(uint8_t);
@@ -48,6 +70,8 @@
   void twi_reply(uint8_t);
   void twi_stop(void);
   void twi_releaseBus(void);
+  uint8_t twi_submitRead(twi_request*);
+  void twi_cancelRead(twi_request*);
 
 #endif
 
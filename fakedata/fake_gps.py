@@ -0,0 +1,214 @@
+"""
+Fake GPS module for exercising GTPA010::configure() without the hardware.
+
+Emits GPGGA/GPRMC (and GPGSA/GPGSV until told otherwise) for a fixed
+position and answers the PMTK commands the client sends:
+
+  PMTK251,<baud>     switch UART rate, no ack (like the real module)
+  PMTK220,<ms>       fix interval, acked with PMTK001,220,3
+  PMTK314,...        sentence output mask, acked with PMTK001,314,3
+
+Run it on a USB serial adapter wired to the Mega's Serial2 pins:
+  python3 fake_gps.py -s /dev/ttyUSB0
+or on a pty pair to watch the handshake from another program:
+  python3 fake_gps.py --pty
+which prints the name of the other end of the pair.
+
+--refuse makes it nack every command and ignore rate changes, so the
+client's fallbacks can be tested too.
+
+Requires pyserial for -s.
+"""
+
+import argparse
+import os
+import sys
+import time
+import tty
+
+BASE_RATE = 4800
+
+
+def checksum(body):
+    """
+    NMEA checksum of the text between $ and *.
+
+    >>> checksum("PMTK001,314,3")
+    '36'
+    """
+    c = 0
+    for ch in body:
+        c ^= ord(ch)
+    return "{:02X}".format(c)
+
+
+def sentence(body):
+    """
+    >>> sentence("PMTK001,220,3")
+    b'$PMTK001,220,3*30\\r\\n'
+    """
+    return bytes("${}*{}\r\n".format(body, checksum(body)), encoding='ascii')
+
+
+def parse(line):
+    """
+    Returns the body of a well formed sentence, or None.
+
+    >>> parse(b"$PMTK220,200*2C\\r\\n")
+    'PMTK220,200'
+    >>> parse(b"$PMTK220,200*2D\\r\\n") is None
+    True
+    """
+    text = line.decode('ascii', errors='replace').strip()
+    if not text.startswith("$") or "*" not in text:
+        return None
+    body, cs = text[1:].split("*", 1)
+    return body if cs.upper() == checksum(body) else None
+
+
+class FdPort:
+    """
+    Minimal pyserial-like wrapper around the master side of a pty.
+    A pty has no real line rate, so baud changes are only recorded.
+    """
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.baudrate = BASE_RATE
+        self.pending = b""
+
+    def write(self, data):
+        os.write(self.fd, data)
+
+    def lines(self):
+        """Return any complete lines received so far, without blocking."""
+        try:
+            import select
+            while select.select([self.fd], [], [], 0)[0]:
+                self.pending += os.read(self.fd, 256)
+        except OSError:
+            pass
+        *done, self.pending = self.pending.split(b"\n")
+        return done
+
+
+class SerialPort:
+    def __init__(self, port):
+        import serial
+        self.port = serial.Serial(port, BASE_RATE, timeout=0)
+        self.pending = b""
+
+    @property
+    def baudrate(self):
+        return self.port.baudrate
+
+    @baudrate.setter
+    def baudrate(self, rate):
+        self.port.baudrate = rate
+
+    def write(self, data):
+        self.port.write(data)
+
+    def lines(self):
+        self.pending += self.port.read(256)
+        *done, self.pending = self.pending.split(b"\n")
+        return done
+
+
+class FakeGps:
+    def __init__(self, port, refuse=False, verbose=False):
+        self.port = port
+        self.refuse = refuse
+        self.verbose = verbose
+        self.interval = 1.0
+        self.chatter = True    # GSA/GSV until a PMTK314 turns them off
+
+    def command(self, body):
+        self.verbose and print("got:", body, file=sys.stderr)
+        fields = body.split(",")
+        cmd = fields[0]
+
+        if cmd == "PMTK251":
+            if not self.refuse:
+                time.sleep(0.05)
+                self.port.baudrate = int(fields[1])
+            return
+        if cmd not in ("PMTK220", "PMTK314"):
+            return
+
+        if self.refuse:
+            self.port.write(sentence("PMTK001,{},2".format(cmd[4:])))
+            return
+        if cmd == "PMTK220":
+            self.interval = int(fields[1]) / 1000
+        else:
+            # GLL, RMC, VTG, GGA, GSA, GSV, ...
+            self.chatter = fields[5] != "0" or fields[6] != "0"
+        self.port.write(sentence("PMTK001,{},3".format(cmd[4:])))
+
+    def fix(self):
+        t = time.strftime("%H%M%S", time.gmtime()) + ".{:03d}".format(
+            int(time.time() * 1000) % 1000)
+        self.port.write(sentence(
+            "GPGGA,{},5331.6236,N,11331.8349,W,1,08,0.95,668.2,M,-17.4,M,,"
+            .format(t)))
+        if self.chatter:
+            self.port.write(sentence(
+                "GPGSA,A,3,10,07,05,02,29,04,08,13,,,,,1.72,1.03,1.38"))
+            self.port.write(sentence(
+                "GPGSV,1,1,04,10,63,137,17,07,61,098,15,05,59,290,20,08,54,157,30"))
+        self.port.write(sentence(
+            "GPRMC,{},A,5331.6236,N,11331.8349,W,0.13,309.62,{},,"
+            .format(t, time.strftime("%d%m%y", time.gmtime()))))
+
+    def run(self):
+        next_fix = time.time()
+        while True:
+            for line in self.port.lines():
+                body = parse(line)
+                if body:
+                    self.command(body)
+            if time.time() >= next_fix:
+                self.fix()
+                next_fix += self.interval
+            time.sleep(0.01)
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description='Fake PMTK GPS module.')
+    parser.add_argument('-s', '--serial',
+                        help='path to serial port',
+                        dest='serialport',
+                        default=None)
+    parser.add_argument('--pty',
+                        help='create a pty pair and use the master side',
+                        action='store_true')
+    parser.add_argument('--refuse',
+                        help='nack every command and ignore rate changes',
+                        action='store_true')
+    parser.add_argument('-v', dest='verbose',
+                        help='verbose',
+                        action='store_true')
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    if args.pty:
+        master, slave = os.openpty()
+        tty.setraw(slave)
+        print("Fake GPS on {}".format(os.ttyname(slave)))
+        port = FdPort(master)
+    elif args.serialport:
+        port = SerialPort(args.serialport)
+    else:
+        print("Supply a serial port with -s, or use --pty")
+        exit()
+
+    FakeGps(port, args.refuse, args.verbose).run()
+
+
+if __name__ == "__main__":
+    main()
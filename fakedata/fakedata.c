@@ -1,199 +1,163 @@
-int lon [] {
--11353058, 
--11353063, 
--11353063, 
--11353063, 
--11353063, 
--11353061, 
--11353061, 
--11353060, 
--11353059, 
--11353077, 
--11353116, 
--11353191, 
--11353286, 
--11353331, 
--11353380, 
--11353422, 
--11353427, 
--11353426, 
--11353422, 
--11353425, 
--11353426, 
--11353416, 
--11353415, 
--11353410, 
--11353404, 
--11353399, 
--11353396, 
--11353392, 
--11353388, 
--11353384, 
--11353382, 
--11353379, 
--11353374, 
--11353371, 
--11353367, 
--11353365, 
--11353362, 
--11353357, 
--11353354, 
--11353349, 
--11353346, 
--11353342, 
--11353339, 
--11353334, 
--11353333, 
--11353329, 
--11353325, 
--11353322, 
--11353319, 
--11353317, 
--11353316, 
--11353313, 
--11353311, 
--11353309, 
--11353306, 
--11353305, 
--11353301, 
--11353299, 
--11353297, 
--11353295, 
--11353293, 
--11353290, 
--11353287, 
--11353287, 
--11353285, 
--11353282, 
--11353280, 
--11353278, 
--11353274, 
--11353269, 
--11353264, 
--11353262, 
--11353258, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353254, 
--11353246, 
--11353065, 
--11353060, 
--11353063, 
--11353062, 
--11353063, 
--11353063, 
--11352909, 
--11352743, 
--11352656, 
--11352603, 
--11352587, 
--11352570, 
--11352563}; 
-
-int lat [] {
-53527063,
-53527592,
-53527661,
-53527696,
-53527742,
-53527816,
-53527846,
-53527871,
-53527911,
-53527992,
-53527987,
-53527913,
-53527990,
-53527970,
-53527967,
-53527948,
-53527675,
-53527389,
-53527094,
-53526716,
-53526463,
-53526374,
-53526348,
-53526333,
-53526313,
-53526303,
-53526288,
-53526268,
-53526243,
-53526228,
-53526213,
-53526198,
-53526178,
-53526168,
-53526153,
-53526138,
-53526128,
-53526113,
-53526108,
-53526098,
-53526093,
-53526083,
-53526068,
-53526048,
-53526028,
-53526013,
-53525998,
-53525973,
-53525963,
-53525933,
-53525913,
-53525887,
-53525862,
-53525838,
-53525823,
-53525803,
-53525778,
-53525758,
-53525738,
-53525718,
-53525693,
-53525673,
-53525658,
-53525633,
-53525608,
-53525588,
-53525573,
-53525547,
-53525547,
-53525547,
-53525547,
-53525557,
-53525572,
-53525592,
-53525617,
-53525627,
-53525652,
-53525687,
-53525712,
-53525731,
-53525756,
-53525781,
-53525801,
-53525821,
-53526317,
-53526318,
-53525954,
-53525658,
-53525383,
-53525015,
-53524898,
-53524858,
-53524836,
-53524833,
-53524834,
-53524912,
-53524995,
-53525044};
\ No newline at end of file
+/*
+ Turns the path drawn in a Google Earth KML file into a fake GPS trace
+ for the client, client/gps_fake_data.h.
+
+ The first <coordinates> list in the file is used, one point per second
+ of the trace.  Positions are truncated to the 1e-5 degree units TinyGPS
+ reports.  So that the trace costs flash and not SRAM, it is stored as a
+ PROGMEM byte stream: for each point the change in latitude, then in
+ longitude, from the point before (the first from 0, 0).  Each change is
+ zigzag encoded (0, -1, 1, -2 ... become 0, 1, 2, 3 ...) and written 7 bits
+ at a time, low bits first, with the top bit set on all but the last byte.
+ Walking paces fit in one byte per coordinate.
+
+ Build and run:
+   cc -o fakedata fakedata.c
+   ./fakedata "calvun path.kml" > ../client/gps_fake_data.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Most points a trace may have, an hour at one per second
+#define MAX_POINTS 3600
+
+static int32_t lat[MAX_POINTS];
+static int32_t lon[MAX_POINTS];
+
+// Reads the whole file into a 0 terminated buffer, or returns 0.
+static char *read_file(const char *name) {
+    FILE *f = fopen(name, "rb");
+    if (!f) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    char *buf = malloc(size + 1);
+    if (buf && fread(buf, 1, size, f) != (size_t) size) {
+        free(buf);
+        buf = 0;
+    }
+    fclose(f);
+    if (buf) {
+        buf[size] = 0;
+    }
+    return buf;
+}
+
+// Parses the "lon,lat,alt lon,lat,alt ..." list after <coordinates>.
+// Returns the number of points, or -1 if there is no list.
+static int parse_kml(char *kml) {
+    char *p = strstr(kml, "<coordinates>");
+    if (!p) {
+        return -1;
+    }
+    p += strlen("<coordinates>");
+    char *end = strstr(p, "</coordinates>");
+    if (end) {
+        *end = 0;
+    }
+
+    int n = 0;
+    while (n < MAX_POINTS) {
+        char *next;
+        double x = strtod(p, &next);
+        if (next == p || *next != ',') {
+            break;
+        }
+        p = next + 1;
+        double y = strtod(p, &next);
+        if (next == p) {
+            break;
+        }
+        p = next;
+
+        // skip the altitude
+        if (*p == ',') {
+            strtod(p + 1, &p);
+        }
+
+        // truncate like TinyGPS does
+        lon[n] = (int32_t) (x * 100000);
+        lat[n] = (int32_t) (y * 100000);
+        n++;
+    }
+    return n;
+}
+
+static int column;
+
+// Writes one stream byte, twelve to a line.
+static void put_byte(uint8_t b) {
+    if (column == 0) {
+        printf("    ");
+    }
+    printf("0x%02x,", b);
+    if (++column == 12) {
+        printf("\n");
+        column = 0;
+    } else {
+        printf(" ");
+    }
+}
+
+// Writes a zigzag varint, returns the number of bytes.
+static int put_delta(int32_t delta) {
+    uint32_t z = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+    int bytes = 1;
+
+    while (z >= 0x80) {
+        put_byte((z & 0x7F) | 0x80);
+        z >>= 7;
+        bytes++;
+    }
+    put_byte(z);
+    return bytes;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s path.kml > gps_fake_data.h\n", argv[0]);
+        return 1;
+    }
+
+    char *kml = read_file(argv[1]);
+    if (!kml) {
+        fprintf(stderr, "%s: could not read %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    int n = parse_kml(kml);
+    free(kml);
+    if (n <= 0) {
+        fprintf(stderr, "%s: no coordinates in %s\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    printf("// Fake GPS trace generated by fakedata/fakedata.c from %s,\n",
+           argv[1]);
+    printf("// do not edit.  %d points, deltas from the point before as\n", n);
+    printf("// zigzag varints, latitude then longitude.\n\n");
+    printf("#include <avr/pgmspace.h>\n\n");
+    printf("const int fd_len = %d;\n\n", n);
+    printf("const uint8_t fd_stream[] PROGMEM = {\n");
+
+    int32_t prev_lat = 0, prev_lon = 0;
+    int bytes = 0;
+    for (int i = 0; i < n; i++) {
+        bytes += put_delta(lat[i] - prev_lat);
+        bytes += put_delta(lon[i] - prev_lon);
+        prev_lat = lat[i];
+        prev_lon = lon[i];
+    }
+    if (column != 0) {
+        printf("\n");
+    }
+    printf("};\n");
+
+    fprintf(stderr, "%d points in %d bytes\n", n, bytes);
+    return 0;
+}
@@ -0,0 +1,201 @@
+"""
+Serial baud rate negotiation, server side.
+
+Every session starts at BASE_RATE.  The client may propose a faster rate
+with a "B <rate>" line.  If the rate is supported the server answers
+"A <rate>", and both ends switch.  The client then sends "S" at the new
+rate, and the server answers "S".  If the sync does not arrive within
+SYNC_TIMEOUT seconds the server goes back to BASE_RATE, which is what the
+client does when it gets no sync reply.
+
+Once running at a negotiated rate, the server goes back to BASE_RATE when
+it has had no well formed message for LINK_TIMEOUT seconds, whether the
+line went quiet or only garbage came in.  The client keeps the same clock:
+it stops using the fast rate well before LINK_TIMEOUT has passed since its
+last request, and after an error it waits out LINK_TIMEOUT at BASE_RATE
+before negotiating again.  Neither end has to understand the other for
+both to end up at BASE_RATE.  The caller reads with timeout() as the port
+timeout, so a quiet line still gets back to handle().
+
+The handshake only needs readline(), write(), flush() and the baudrate and
+timeout attributes of a pyserial port, so it can be tried over a pty pair
+with dumb_server.py standing in for the real server.
+
+>>> clock = FakeClock()
+>>> port = FakePort([b"S\\n"])
+>>> link = Negotiator(port, clock=clock)
+>>> link.handle("B 115200")
+True
+>>> port.baudrate, port.sent
+(115200, [b'A 115200\\n', b'S\\n'])
+>>> link.timeout()
+10.0
+
+A rate the server does not support is refused, and the sync timing out
+puts the server back at the base rate.
+
+>>> port = FakePort([])
+>>> link = Negotiator(port)
+>>> link.handle("B 300")
+True
+>>> port.sent
+[b'N\\n']
+>>> link.handle("B 57600")
+True
+>>> port.baudrate
+9600
+
+Ordinary messages are left for the caller, who reports the well formed
+ones with ok().  Garbled messages do not keep the link up, and neither
+does silence: once LINK_TIMEOUT has passed without a good message the
+next line, or the empty read when the port times out, puts the server
+back at the base rate.
+
+>>> port = FakePort([b"S\\n"])
+>>> link = Negotiator(port, clock=clock)
+>>> link.handle("B 250000")
+True
+>>> link.handle("5352706 -11353058 5352491 -11352563")
+False
+>>> link.ok()
+>>> clock.now += 6
+>>> link.handle(b"\\xe3\\x8f".decode('ascii', errors='replace'))
+True
+>>> link.timeout(), port.baudrate
+(4.0, 250000)
+>>> clock.now += 4
+>>> link.handle("")
+True
+>>> port.baudrate, link.timeout()
+(9600, None)
+"""
+
+import time
+
+BASE_RATE = 9600
+RATES = (57600, 115200, 250000)
+SYNC_TIMEOUT = 1.0
+
+# Must match SERIAL_LINK_TIMEOUT in the client's serial_handling.h
+LINK_TIMEOUT = 10.0
+
+
+class Negotiator:
+    """
+    Handles baud rate control messages from the client on one serial port.
+    """
+
+    def __init__(self, serial_port, debug=False, clock=time.monotonic):
+        self.port = serial_port
+        self.debug = debug
+        self.clock = clock
+        self.last_ok = clock()
+
+    def _send(self, message):
+        self.port.write(bytes(message + "\n", encoding='ascii'))
+        self.port.flush()
+
+    def _set_rate(self, rate):
+        self.debug and print("Switching to {} baud".format(rate))
+        self.port.baudrate = rate
+        self.last_ok = self.clock()
+
+    def handle(self, msg):
+        """
+        Process msg if it is part of the handshake, or count it as an error
+        if it is garbled.  Returns True if the message was consumed, False
+        if the caller should handle it.
+        """
+        if (self.port.baudrate != BASE_RATE and
+                self.clock() - self.last_ok >= LINK_TIMEOUT):
+            # Nothing good for too long, the client has given up on this
+            # rate as well.
+            self._set_rate(BASE_RATE)
+            return True
+
+        if msg == "" or "\ufffd" in msg:
+            # A read that timed out, or bytes that did not decode, most
+            # likely a rate mismatch.
+            return True
+
+        fields = msg.split(" ")
+        if len(fields) != 2 or fields[0] != "B":
+            return False
+
+        try:
+            rate = int(fields[1])
+        except ValueError:
+            rate = None
+
+        if rate not in RATES:
+            self._send("N")
+            return True
+
+        self._send("A {}".format(rate))
+        try:
+            self._set_rate(rate)
+        except (ValueError, OSError):
+            # The port can't do this rate after all.  The client will get
+            # no sync reply and fall back as well.
+            self._set_rate(BASE_RATE)
+            return True
+
+        old_timeout = self.port.timeout
+        self.port.timeout = SYNC_TIMEOUT
+        sync = self.port.readline()
+        self.port.timeout = old_timeout
+
+        if sync.rstrip(b"\r\n") == b"S":
+            self._send("S")
+        else:
+            self._set_rate(BASE_RATE)
+        return True
+
+    def ok(self):
+        """
+        Record a well formed message from the client, which keeps a
+        negotiated rate up for another LINK_TIMEOUT seconds.
+        """
+        self.last_ok = self.clock()
+
+    def timeout(self):
+        """
+        The read timeout to use for the next message, in seconds: None at
+        the base rate, otherwise what is left of LINK_TIMEOUT.
+        """
+        if self.port.baudrate == BASE_RATE:
+            return None
+        return max(self.last_ok + LINK_TIMEOUT - self.clock(), 0.001)
+
+
+class FakeClock:
+    """
+    Stand-in for time.monotonic() that only moves when told to.
+    """
+
+    def __init__(self):
+        self.now = 0.0
+
+    def __call__(self):
+        return self.now
+
+
+class FakePort:
+    """
+    Stand-in for a serial port that replays canned client lines.
+    """
+
+    def __init__(self, lines):
+        self.lines = list(lines)
+        self.sent = []
+        self.baudrate = BASE_RATE
+        self.timeout = None
+
+    def readline(self):
+        return self.lines.pop(0) if self.lines else b""
+
+    def write(self, data):
+        self.sent.append(data)
+
+    def flush(self):
+        pass
@@ -1,6 +1,7 @@
 import sys
 import serial
 import argparse
+import baud
 
 global debug
 debug = False
@@ -11,7 +12,7 @@ def main():
     # Initialize some stuff...
     if args.serialport:
         print("Opening serial port: %s" % args.serialport)
-        serial_out = serial_in =  serial.Serial(args.serialport, 9600)
+        serial_out = serial_in =  serial.Serial(args.serialport, baud.BASE_RATE)
     else:
         print("No serial port.  Supply one with the -s port option")
         exit()
@@ -21,15 +22,22 @@ def main():
     else:
         debug = False
 
+    link = baud.Negotiator(serial_in, debug)
+
     idx = 0
     while True:
+        serial_in.timeout = link.timeout()
         msg = receive(serial_in)
 
         debug and print("GOT:" + msg + ":", file=sys.stderr)
 
+        if link.handle(msg):
+            continue
+
         fields = msg.split(" ");
 
         if len(fields) == 4:
+            link.ok()
             send(serial_out, "2")
             send(serial_out, fields[0]+" "+fields[1])
             send(serial_out, fields[2]+" "+fields[3])
@@ -57,7 +65,7 @@ def receive(serial_port, timeout=None):
 
     debug and print("client:", raw_message, ":")
 
-    message = raw_message.decode('ascii')
+    message = raw_message.decode('ascii', errors='replace')
 
     return message.rstrip("\n\r")
 
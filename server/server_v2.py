@@ -13,6 +13,7 @@ occurred with several students: Anders Muskens, Stefan Martynkiw
 """
 
 import argparse
+import baud
 import digraph
 import pqueue
 import readgraph
@@ -45,7 +46,7 @@ def receive(serial_port, timeout=None):
 
     debug and print("client:", raw_message, ":")
 
-    message = raw_message.decode('ascii')
+    message = raw_message.decode('ascii', errors='replace')
 
     return message.rstrip("\n\r")
 
@@ -221,7 +222,7 @@ def main():
     try:
         if args.serialport:
             print("Opening serial port: {}".format(args.serialport))
-            serial_out = serial_in = serial.Serial(args.serialport, 9600)
+            serial_out = serial_in = serial.Serial(args.serialport, baud.BASE_RATE)
         else:
             print("No serial port. Supply one with the -s port option.")
             exit()
@@ -235,8 +236,11 @@ def main():
         debug = True
     else:
         debug = False
+
     debug = True
 
+    link = baud.Negotiator(serial_in, debug)
+
     # Generate a graph from the map and grab the needed values
     G = digraph.Digraph(E)
     # Add all orphan vertices. Not really useful, and in fact detrimental
@@ -256,20 +260,33 @@ def main():
 
     # Parse input
     while True:
+        # a quiet line at a negotiated rate has to come back to the
+        # handshake code, which puts it back at the base rate
+        serial_in.timeout = link.timeout()
         msg = receive(serial_in)
         debug and print("GOT:{}:".format(msg), file=sys.stderr)
 
+        # Baud rate handshake and garbled input
+        if link.handle(msg):
+            continue
+
         fields = msg.split(" ")
 
         # Ignore malformed messages
         if len(fields) != 4:
             debug and print("Ignoring message: {}".format(msg))
             continue
+        try:
+            coords = [int(f) for f in fields]
+        except ValueError:
+            debug and print("Bad coordinates: {}".format(msg))
+            continue
+        link.ok()
         time1 = time.time()
         print("Processing..")
         # Get start and end vertices
-        start_v = (int(fields[0])/10**5, int(fields[1])/10**5)
-        end_v = (int(fields[2])/10**5, int(fields[3])/10**5)
+        start_v = (coords[0]/10**5, coords[1]/10**5)
+        end_v = (coords[2]/10**5, coords[3]/10**5)
         start = nearest_vertex( start_v )
         end = nearest_vertex( end_v )
 
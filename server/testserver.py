@@ -1,4 +1,6 @@
+import baud
 import doctest
 import server
 
+doctest.testmod(baud)
 doctest.testmod(server)